@@ -0,0 +1,79 @@
+#pragma once
+#include "types.h"
+#include "index_blob.h"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstddef>
+using namespace std;
+
+// Contiguous run of dense ids (a slice of the index, no copy)
+struct IdRange {
+    const DenseId* first = nullptr;
+    const DenseId* last = nullptr;
+
+    const DenseId* begin() const { return first; }
+    const DenseId* end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+};
+
+// Compressed sparse row index from artist dense id to the dense ids of the
+// artist's songs: song_ids_[offsets_[a], offsets_[a + 1]) are artist a's songs
+// in ascending id order. Built by a counting sort over the songs, so one pass
+// to count and one to fill.
+//
+// When the song catalog was renumbered with artistOrder(), every artist's ids
+// are also consecutive, and their rows in the song store sit next to each other.
+//
+// Deltas rewrite only the buckets they touch: a rewritten bucket moves to a side
+// table that shadows its CSR slice, until enough songs sit there that the owner
+// folds them back with a full build() (patchesFull()).
+class ArtistSongIndex {
+public:
+    void build(const ArtistDatabase& artists, const SongDatabase& songs);
+    void clear();
+
+    // the CSR arrays, for a catalog snapshot; save() declines (false) while
+    // patched buckets are pending
+    bool save(BlobWriter& out) const;
+    bool load(BlobReader& in);
+
+    // move changed songs between buckets, and songs whose artist appeared or
+    // disappeared to or from the unattributed bucket (catalogs already updated)
+    void update(const ArtistDatabase& artists, const SongDatabase& songs,
+                const vector<DenseId>& upserted_artists, const vector<DenseId>& deleted_artists,
+                const vector<DenseId>& upserted_songs, const vector<DenseId>& deleted_songs);
+    bool patchesFull() const { return patched_songs_ > max<size_t>(kMinPatched, song_count_ / 8); }
+
+    // songs of one artist (empty for unknown or erased artists)
+    IdRange songsOf(DenseId artist) const;
+    // songs whose artist_id matches no artist
+    IdRange unattributed() const { return bucket(kUnattributed); }
+
+    size_t artistBound() const { return artist_bound_; }
+    size_t songCount() const { return song_count_; }
+
+    // live song ids grouped by artist (artists in dense id order, unattributed
+    // songs last), for DenseCatalog::reorder
+    static vector<DenseId> artistOrder(const ArtistDatabase& artists, const SongDatabase& songs);
+
+private:
+    static constexpr DenseId kUnattributed = kInvalidDenseId;    // bucket key of songs without an artist
+    static constexpr DenseId kNotIndexed = kInvalidDenseId - 1;  // song_artist_ of ids not in any bucket
+    static constexpr size_t kMinPatched = 1024;                  // patched songs always allowed
+
+    size_t artist_bound_ = 0;
+    vector<size_t> offsets_;   // artist_bound_ + 2 entries: one bucket per artist, then unattributed
+    vector<DenseId> song_ids_;
+    vector<DenseId> song_artist_; // song dense id -> its bucket key
+    size_t song_count_ = 0;
+
+    // rewritten buckets by key (sorted ids); they shadow their CSR slices
+    unordered_map<DenseId, vector<DenseId>> patched_;
+    size_t patched_songs_ = 0;
+
+    IdRange bucket(DenseId key) const;
+    IdRange slice(size_t bucket) const;
+    vector<DenseId>& patchedBucket(DenseId key);
+};
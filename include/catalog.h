@@ -0,0 +1,248 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <array>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include "cow_ptr.h"
+using namespace std;
+
+// Position of a record in a catalog; assigned at insert time and stable until compact()/reorder()
+using DenseId = uint32_t;
+
+constexpr DenseId kInvalidDenseId = numeric_limits<DenseId>::max();
+
+// Records addressed by dense ids, with a dictionary from the external id
+// (Record::id, e.g. a PackedId) to the dense id and back.
+//
+// Erasing leaves a tombstone so the ids of other records never move; compact()
+// squeezes the tombstones out in one pass and reports how ids were remapped,
+// reorder() does the same while also choosing the new order.
+// Range-for visits live records in id order.
+//
+// Records live in fixed-size segments and the dictionary in hash shards, each
+// shared copy-on-write (CowPtr): copying a catalog shares all of them, and a
+// change then clones only the segments and shards it touches. Non-const access
+// (operator[], get, iterating a non-const catalog) counts as a change.
+template <typename Record>
+class DenseCatalog {
+public:
+    using mapped_type = Record;
+    using key_type = decltype(Record::id);
+
+    static constexpr size_t kSegmentBits = 10;
+    static constexpr size_t kSegmentSize = size_t(1) << kSegmentBits;
+    static constexpr size_t kIndexShards = 64;
+
+    template <typename Value, typename Catalog>
+    class Iterator {
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = Record;
+        using difference_type = ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+
+        Iterator(Catalog* catalog, DenseId id) : catalog_(catalog), id_(id) { skipDead(); }
+
+        reference operator*() const { return (*catalog_)[id_]; }
+        pointer operator->() const { return &(*catalog_)[id_]; }
+        DenseId id() const { return id_; }
+
+        Iterator& operator++() {
+            ++id_;
+            skipDead();
+            return *this;
+        }
+        bool operator==(const Iterator& other) const { return id_ == other.id_; }
+        bool operator!=(const Iterator& other) const { return id_ != other.id_; }
+
+    private:
+        Catalog* catalog_;
+        DenseId id_;
+
+        void skipDead() {
+            while (id_ < catalog_->idBound() && !catalog_->contains(id_)) ++id_;
+        }
+    };
+
+    using iterator = Iterator<Record, DenseCatalog>;
+    using const_iterator = Iterator<const Record, const DenseCatalog>;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, idBound()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, idBound()); }
+
+    // live records
+    size_t size() const { return live_count_; }
+    bool empty() const { return live_count_ == 0; }
+
+    // every dense id is below idBound(); ids of erased records stay reserved until compact()
+    DenseId idBound() const { return static_cast<DenseId>(bound_); }
+    bool contains(DenseId id) const { return id < bound_ && segment(id).live[offset(id)]; }
+    size_t tombstones() const { return bound_ - live_count_; }
+
+    // external id -> dense id (kInvalidDenseId when absent)
+    DenseId find(const key_type& key) const {
+        const Index& shard = *index_[shardOf(key)];
+        auto it = shard.find(key);
+        return it != shard.end() ? it->second : kInvalidDenseId;
+    }
+
+    // dense id -> external id
+    const key_type& key(DenseId id) const { return (*this)[id].id; }
+
+    Record& operator[](DenseId id) { return segments_[id >> kSegmentBits].write().records[offset(id)]; }
+    const Record& operator[](DenseId id) const { return segment(id).records[offset(id)]; }
+
+    Record* get(const key_type& key) {
+        DenseId id = find(key);
+        return id != kInvalidDenseId ? &(*this)[id] : nullptr;
+    }
+    const Record* get(const key_type& key) const {
+        DenseId id = find(key);
+        return id != kInvalidDenseId ? &(*this)[id] : nullptr;
+    }
+
+    // insert by record.id, or replace the record already stored under it (keeping its dense id);
+    // returns the dense id and whether it was newly assigned
+    pair<DenseId, bool> insert_or_assign(Record&& record) {
+        DenseId id = find(record.id);
+        if (id != kInvalidDenseId) {
+            (*this)[id] = std::move(record);
+            return {id, false};
+        }
+        id = idBound();
+        index_[shardOf(record.id)].write().emplace(record.id, id);
+        append(segments_, bound_, std::move(record));
+        ++live_count_;
+        return {id, true};
+    }
+    pair<DenseId, bool> insert_or_assign(const Record& record) {
+        Record copy = record;
+        return insert_or_assign(std::move(copy));
+    }
+
+    // insert_or_assign every record of `batch` in order, moving the batch in
+    // one pass: ids are assigned first, then the records are appended in bulk
+    // (or scattered when the batch replaces records). on_replace(dense id) is
+    // called in batch order for every record that replaced another.
+    template <typename OnReplace>
+    void insert_or_assign_all(vector<Record>&& batch, OnReplace on_replace) {
+        const DenseId first = idBound();
+        DenseId next = first;
+        vector<DenseId> targets(batch.size());
+        vector<DenseId> replaced;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            DenseId id = find(batch[i].id);
+            if (id == kInvalidDenseId) {
+                id = next++;
+                index_[shardOf(batch[i].id)].write().emplace(batch[i].id, id);
+            } else {
+                replaced.push_back(id);
+            }
+            targets[i] = id;
+        }
+
+        if (replaced.empty()) {
+            for (Record& record : batch) append(segments_, bound_, std::move(record));
+        } else {
+            while (bound_ < next) append(segments_, bound_, Record());
+            for (size_t i = 0; i < batch.size(); ++i) (*this)[targets[i]] = std::move(batch[i]);
+        }
+        live_count_ += next - first;
+        for (DenseId id : replaced) on_replace(id);
+    }
+
+    // remove by external id; returns the freed dense id (kInvalidDenseId when absent)
+    DenseId erase(const key_type& key) {
+        DenseId id = find(key);
+        if (id == kInvalidDenseId) return kInvalidDenseId;
+        index_[shardOf(key)].write().erase(key);
+        Segment& segment = segments_[id >> kSegmentBits].write();
+        segment.records[offset(id)] = Record();
+        segment.live[offset(id)] = 0;
+        --live_count_;
+        return id;
+    }
+
+    // drop tombstones, keeping the relative order of live records;
+    // returns old id -> new id (kInvalidDenseId for erased records)
+    vector<DenseId> compact() {
+        vector<DenseId> order;
+        order.reserve(live_count_);
+        for (DenseId id = 0; id < bound_; ++id) {
+            if (contains(id)) order.push_back(id);
+        }
+        return reorder(order);
+    }
+
+    // renumber the records listed in `order` as 0, 1, 2, ...; records not listed
+    // (including tombstones) are dropped. Returns old id -> new id like compact().
+    vector<DenseId> reorder(const vector<DenseId>& order) {
+        vector<DenseId> remap(bound_, kInvalidDenseId);
+        vector<CowPtr<Segment>> segments;
+        size_t bound = 0;
+        segments.reserve(order.size() / kSegmentSize + 1);
+        for (DenseId id : order) {
+            if (!contains(id) || remap[id] != kInvalidDenseId) continue;
+            remap[id] = static_cast<DenseId>(bound);
+            // records still shared with another catalog are copied, not moved
+            CowPtr<Segment>& source = segments_[id >> kSegmentBits];
+            if (source.unique()) append(segments, bound, std::move(source.write().records[offset(id)]));
+            else append(segments, bound, Record((*source).records[offset(id)]));
+        }
+        for (auto& shard : index_) {
+            Index& index = shard.write();
+            for (auto it = index.begin(); it != index.end();) {
+                it->second = remap[it->second];
+                it = it->second == kInvalidDenseId ? index.erase(it) : std::next(it);
+            }
+        }
+        segments_ = std::move(segments);
+        bound_ = live_count_ = bound;
+        return remap;
+    }
+
+    void reserve(size_t count) {
+        segments_.reserve(count / kSegmentSize + 1);
+        for (auto& shard : index_) shard.write().reserve(count / kIndexShards + 1);
+    }
+
+    void clear() {
+        segments_.clear();
+        for (auto& shard : index_) shard = CowPtr<Index>();
+        bound_ = 0;
+        live_count_ = 0;
+    }
+
+private:
+    struct Segment {
+        vector<Record> records; // up to kSegmentSize, ids from segment number << kSegmentBits
+        vector<uint8_t> live;   // 0 = tombstone
+    };
+    using Index = unordered_map<key_type, DenseId>;
+
+    vector<CowPtr<Segment>> segments_;
+    array<CowPtr<Index>, kIndexShards> index_;
+    size_t bound_ = 0;
+    size_t live_count_ = 0;
+
+    static size_t offset(DenseId id) { return id & (kSegmentSize - 1); }
+    static size_t shardOf(const key_type& key) { return hash<key_type>()(key) % kIndexShards; }
+    const Segment& segment(DenseId id) const { return *segments_[id >> kSegmentBits]; }
+
+    // add a live record as id `bound` (a new segment every kSegmentSize records)
+    static void append(vector<CowPtr<Segment>>& segments, size_t& bound, Record&& record) {
+        if (bound % kSegmentSize == 0) segments.emplace_back();
+        Segment& segment = segments.back().write();
+        segment.records.push_back(std::move(record));
+        segment.live.push_back(1);
+        ++bound;
+    }
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include "types.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+// Where a catalog record came from; later sources supersede earlier ones
+enum class RecordSource : uint8_t {
+    CSV = 0,
+    Spotify = 1
+};
+
+// Outcome of one merge
+struct MergeStats {
+    size_t incoming = 0;          // records in the batch
+    size_t batch_duplicates = 0;  // same id repeated inside the batch (last one kept)
+    size_t inserted = 0;          // ids new to the catalog
+    size_t replaced = 0;          // existing records superseded by the batch
+    size_t stale_dropped = 0;     // batch records older than what the catalog holds
+};
+
+// Merges batches from different sources into one deduplicated catalog by id.
+// Each batch is sorted and deduplicated once, then applied in a single pass
+// through the catalog's id dictionary, moving records instead of copying them.
+// Provenance is kept per dense id.
+class CatalogMerger {
+public:
+    MergeStats mergeArtists(ArtistDatabase& catalog, vector<Artist>&& incoming, RecordSource source);
+    MergeStats mergeSongs(SongDatabase& catalog, vector<Song>&& incoming, RecordSource source);
+
+    // forget provenance of removed records (e.g. after delta deletes)
+    void forgetArtist(DenseId id) { forget(artist_versions_, id); }
+    void forgetSong(DenseId id) { forget(song_versions_, id); }
+
+    // squeeze tombstones out of a catalog, keeping provenance aligned with the new ids;
+    // returns the catalog's old id -> new id map
+    vector<DenseId> compactArtists(ArtistDatabase& catalog);
+    vector<DenseId> compactSongs(SongDatabase& catalog);
+    // same, renumbering the songs in `order` (e.g. ArtistSongIndex::artistOrder)
+    vector<DenseId> reorderSongs(SongDatabase& catalog, const vector<DenseId>& order);
+
+private:
+    // A record version: higher source wins, then the more recent sync
+    struct Version {
+        RecordSource source = RecordSource::CSV;
+        uint64_t generation = 0;
+
+        bool supersedes(const Version& other) const {
+            if (source != other.source) return source > other.source;
+            return generation >= other.generation;
+        }
+    };
+
+    uint64_t generation_ = 0;
+    vector<Version> artist_versions_; // by dense id; ids past the end count as CSV, generation 0
+    vector<Version> song_versions_;
+
+    static void forget(vector<Version>& versions, DenseId id) {
+        if (id < versions.size()) versions[id] = Version();
+    }
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include "types.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+class RecommendationEngine;
+
+// One immutable state of the artist and song catalogs. Versions are never
+// modified once published; a change produces the next version.
+struct CatalogVersion {
+    uint64_t number = 0;
+    ArtistDatabase artists;
+    SongDatabase songs;
+    // indexes and ML models of exactly these catalogs, built by the writer that
+    // produced the version and only queried once it is published (null until the
+    // writer builds them; a writer starts from its predecessor's engine and must
+    // replace it before publishing changed catalogs)
+    shared_ptr<RecommendationEngine> engine;
+};
+
+// A pinned version: stays valid for as long as the pointer is held, even after
+// newer versions have been published
+using CatalogSnapshot = shared_ptr<const CatalogVersion>;
+
+// Read-copy-update holder of the current catalog version.
+//
+// Readers pin the current version with one atomic load and never block.
+// Writers are serialized: each copies the current version, changes the copy and
+// publishes it with an atomic pointer swap, so a slow rebuild (for example a
+// Spotify fetch on the background thread) never stalls queries on the old one.
+// The copy is shallow: catalog segments and dictionary shards (DenseCatalog)
+// and engine indexes are copy-on-write, so only what the writer changes is cloned.
+class CatalogHandle {
+public:
+    // changes `next` in place; return false to discard it without publishing
+    using Writer = function<bool(CatalogVersion& next)>;
+
+    CatalogHandle();
+    ~CatalogHandle();
+    CatalogHandle(const CatalogHandle&) = delete;
+    CatalogHandle& operator=(const CatalogHandle&) = delete;
+
+    CatalogSnapshot acquire() const { return atomic_load(&current_); }
+
+    // run `write` against a copy of the current version on this thread and publish
+    // the result; returns the published version (null when `write` declined).
+    // Waits for a background update to finish, so interactive callers check
+    // updatePending() first.
+    CatalogSnapshot update(const Writer& write);
+
+    // same on a background thread; returns false if one is still running
+    bool updateAsync(Writer write);
+    bool updatePending() const { return pending_.load(); }
+    void wait(); // for the background update, if any
+
+private:
+    shared_ptr<const CatalogVersion> current_; // accessed only through atomic_load/atomic_store
+    mutex writer_mutex_;
+    thread worker_;
+    atomic<bool> pending_{false};
+};
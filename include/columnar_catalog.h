@@ -0,0 +1,111 @@
+#pragma once
+#include "types.h"
+#include <string>
+#include <string_view>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+using namespace std;
+
+// Columnar song catalog file.
+//
+// Every column lives in its own page-aligned segment, so a query path maps
+// only the columns it touches: a similarity scan needs features and
+// popularity, while ids and names are faulted in when results are rendered.
+// Popularity and features can optionally be stored as 16-bit quantized values.
+namespace columnar {
+
+constexpr char kMagic[8] = {'M', 'R', 'C', 'O', 'L', 'S', '\0', '\0'};
+constexpr uint32_t kVersion = 2;
+
+enum class ColumnId : uint32_t {
+    Ids = 0,       // string column
+    Names,         // string column
+    ArtistIds,     // string column
+    Popularity,    // double or quantized uint16
+    FeatureDims,   // uint8 per song (features are padded to the common stride)
+    Features,      // row-major, feature_stride values per song
+    Count
+};
+
+enum class Codec : uint32_t {
+    Raw = 0,
+    Quant16 = 1    // value = min[d] + q * (max[d] - min[d]) / 65535, from the segment's
+                   // leading range table of one (min, max) double pair per dimension d
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t segment_count;
+    uint64_t song_count;
+    uint64_t feature_stride;
+};
+
+struct SegmentInfo {
+    uint32_t column;
+    uint32_t codec;
+    uint64_t offset;   // page aligned
+    uint64_t bytes;
+    double min_value;  // Quant16: overall range (per-dimension ranges lead the segment)
+    double max_value;
+};
+
+} // namespace columnar
+
+class ColumnarCatalog {
+public:
+    ColumnarCatalog() = default;
+    ~ColumnarCatalog();
+    ColumnarCatalog(const ColumnarCatalog&) = delete;
+    ColumnarCatalog& operator=(const ColumnarCatalog&) = delete;
+
+    // write the song catalog column by column (compress = quantize numeric columns);
+    // rows follow dense id order, so row == dense id for a catalog without tombstones
+    static bool write(const string& filename, const SongDatabase& songs, bool compress = false);
+
+    // read the header and segment directory; no column is mapped yet
+    bool open(const string& filename);
+    void close();
+    bool isOpen() const { return fd_ >= 0; }
+
+    size_t size() const { return header_.song_count; }
+    size_t featureStride() const { return header_.feature_stride; }
+
+    // row access; the first access to a column maps its segment
+    string_view id(size_t row) const;
+    string_view name(size_t row) const;
+    string_view artistId(size_t row) const;
+    double popularity(size_t row) const;
+    size_t featureCount(size_t row) const;
+    void features(size_t row, double* out) const; // writes featureStride() values, zero padded
+
+    // build a full Song for one row (touches every column)
+    Song materialize(size_t row) const;
+
+    // introspection for the lazy mapping
+    bool isMapped(columnar::ColumnId column) const;
+    size_t mappedBytes() const;
+
+private:
+    struct Column {
+        columnar::SegmentInfo info = {};
+        bool present = false;
+        atomic<const char*> data{nullptr};
+        void* mapping = nullptr;
+        size_t mapping_length = 0;
+    };
+
+    int fd_ = -1;
+    columnar::Header header_ = {};
+    mutable array<Column, static_cast<size_t>(columnar::ColumnId::Count)> columns_;
+    mutable mutex map_mutex_;
+
+    // segment size and codec against the header (string columns: offset table ends)
+    static bool validateSegment(int fd, const columnar::Header& header, const columnar::SegmentInfo& info);
+    const char* columnData(columnar::ColumnId column) const;
+    string_view stringAt(columnar::ColumnId column, size_t row) const;
+    // value `index` of a column with `dims` interleaved dimensions
+    double decode(const Column& column, const char* data, size_t index, size_t dims) const;
+};
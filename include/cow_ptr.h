@@ -0,0 +1,32 @@
+#pragma once
+#include <memory>
+#include <utility>
+using namespace std;
+
+// Shared value with copy-on-write. Copies share one T; write() gives the
+// handle a private copy first if anything else still shares it. An object built
+// from CowPtrs copies in a few reference counts, and a copy that is then changed
+// clones only the parts that are written.
+//
+// write() is for the single owner of an unpublished copy: handles reachable from
+// a published catalog version are only read, by any number of threads.
+template <typename T>
+class CowPtr {
+public:
+    CowPtr() : ptr_(make_shared<T>()) {}
+    explicit CowPtr(T value) : ptr_(make_shared<T>(std::move(value))) {}
+
+    const T& operator*() const { return *ptr_; }
+    const T* operator->() const { return ptr_.get(); }
+
+    // false while another handle shares the value (write() would copy it)
+    bool unique() const { return ptr_.use_count() == 1; }
+
+    T& write() {
+        if (!unique()) ptr_ = make_shared<T>(*ptr_);
+        return *ptr_;
+    }
+
+private:
+    shared_ptr<T> ptr_;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+using namespace std;
+
+// Problems found while tokenizing; counted instead of thrown
+struct ParseErrors {
+    size_t malformed_numbers = 0; // numeric fields that did not parse completely
+    size_t bad_quotes = 0;        // unterminated quotes or text after a closing quote
+
+    size_t total() const { return malformed_numbers + bad_quotes; }
+    ParseErrors& operator+=(const ParseErrors& other) {
+        malformed_numbers += other.malformed_numbers;
+        bad_quotes += other.bad_quotes;
+        return *this;
+    }
+};
+
+// One field of a record, pointing into the tokenized buffer
+struct CsvField {
+    string_view raw;      // field text without surrounding quotes
+    bool escaped = false; // raw still contains doubled quotes ("")
+
+    // copy into a string, turning "" back into "
+    void assignTo(string& out) const;
+    string str() const;
+};
+
+// RFC 4180 tokenizer over an in-memory buffer (e.g. a mapped file).
+// Delimiters are located with SIMD byte scanning, numbers are parsed with
+// from_chars, and malformed input is counted in errors() rather than thrown.
+class CsvTokenizer {
+public:
+    explicit CsvTokenizer(string_view buffer) : buffer_(buffer) {}
+
+    // read the next record; returns false once the buffer is exhausted
+    bool nextRecord(vector<CsvField>& fields);
+
+    // whether the last record ended with a newline (false = cut off at end of buffer)
+    bool lastRecordTerminated() const { return last_terminated_; }
+
+    size_t position() const { return pos_; }
+    const ParseErrors& errors() const { return errors_; }
+    ParseErrors& errors() { return errors_; }
+
+    // parse a whole field as a number; counts a malformed number and returns fallback on failure
+    double parseNumber(string_view text, double fallback);
+
+    // call fn(item) for every `delim`-separated item of a list field (e.g. tags "a;b;c")
+    template <typename Fn>
+    static void forEachListItem(string_view list, char delim, Fn&& fn) {
+        while (!list.empty()) {
+            size_t pos = findByte(list.data(), list.size(), 0, delim);
+            fn(list.substr(0, pos));
+            list = (pos >= list.size()) ? string_view() : list.substr(pos + 1);
+        }
+    }
+
+    // split a buffer into at most `parts` chunks that each end on a record boundary
+    // (newlines inside quoted fields are not boundaries)
+    static vector<string_view> splitRecords(string_view buffer, unsigned parts);
+
+    // SIMD scans; return size when nothing is found
+    static size_t findByte(const char* data, size_t size, size_t pos, char c);
+    static size_t findFieldEnd(const char* data, size_t size, size_t pos); // ',' or '\n'
+    static size_t countByte(const char* data, size_t size, char c);
+
+private:
+    string_view buffer_;
+    size_t pos_ = 0;
+    bool last_terminated_ = false;
+    ParseErrors errors_;
+};
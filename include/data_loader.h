@@ -1,23 +1,147 @@
 #pragma once
 #include "types.h"
+#include "csv_tokenizer.h"
+#include "song_store.h"
 #include <string>
+#include <string_view>
+#include <vector>
+#include <map>
 using namespace std;
 
+// Summary of the most recent load call
+struct LoadStats {
+    size_t rows = 0;        // records parsed (header excluded)
+    size_t bytes = 0;       // size of the input file
+    unsigned threads = 1;   // parser threads used
+    size_t peak_rss_kb = 0; // process peak RSS after the load (0 = not measured)
+    size_t rejected = 0;    // records without an id, skipped
+    ParseErrors errors;     // malformed fields (parsed as 0.0) and quoting problems
+    double seconds = 0.0;   // wall time spent loading
+
+    double rowsPerSecond() const { return seconds > 0.0 ? rows / seconds : 0.0; }
+};
+
+// Outcome of applying a change file
+struct DeltaResult {
+    vector<DenseId> upserted_ids; // inserted or replaced records
+    vector<DenseId> deleted_ids;  // records that existed and were removed (now tombstones)
+    size_t rejected = 0;          // rows with an unknown op or an empty id
+};
+
+// Ids that appeared more than once while loading (later rows replace earlier ones)
+struct DuplicateLog {
+    static constexpr size_t kMaxSamples = 10;
+
+    size_t count = 0;
+    vector<string> samples;
+
+    void note(const string& id) {
+        ++count;
+        if (samples.size() < kMaxSamples) samples.push_back(id);
+    }
+};
+
+// One offending record kept as an example in a validation report
+struct ValidationSample {
+    string check;  // which check failed
+    string id;     // record id
+    string detail; // offending value
+};
+
+// Result of validateData; counts cover the whole catalog, samples are capped
+struct ValidationReport {
+    static constexpr size_t kMaxSamplesPerCheck = 5;
+
+    size_t artists_checked = 0;
+    size_t songs_checked = 0;
+
+    size_t malformed_numbers = 0;        // numeric fields that failed to parse while loading
+    size_t bad_quotes = 0;               // csv quoting problems while loading
+    size_t empty_ids = 0;                // records with an empty id (in the catalog or skipped by a load)
+    size_t key_mismatches = 0;           // id dictionary does not point back at the record
+    size_t duplicate_artist_ids = 0;     // artist rows replaced by a later row with the same id
+    size_t duplicate_song_ids = 0;       // song rows replaced by a later row with the same id
+    size_t missing_artist_refs = 0;      // songs whose artist_id is not in the artist catalog
+    size_t popularity_out_of_range = 0;  // popularity outside [0, 1] or not finite
+    size_t non_finite_features = 0;      // songs with NaN / infinite features
+    size_t feature_dim_mismatches = 0;   // songs whose feature count differs from the common one
+    size_t expected_feature_dims = 0;    // most common feature count
+    size_t artists_without_songs = 0;    // informational, not an error
+    size_t unknown_genres = 0;           // informational: artists whose genre encodeGenre() does not know
+
+    unsigned threads = 1;
+    double seconds = 0.0;
+    vector<ValidationSample> samples;
+
+    size_t errorCount() const;
+    bool ok() const { return errorCount() == 0; }
+
+    // machine-readable form
+    string toJSON(int indent = 2) const;
+};
+
 class DataLoader {
 public:
     // loading artits and songs from csv files
     bool loadArtistsFromCSV(const string& filename, ArtistDatabase& artists);
     bool loadSongsFromCSV(const string& filename, SongDatabase& songs);
 
-    // loading data from json files
+    // loading artists and songs from memory-mapped csv files (zero-copy tokenizing)
+    bool loadArtistsFromCSVMapped(const string& filename, ArtistDatabase& artists);
+    bool loadSongsFromCSVMapped(const string& filename, SongDatabase& songs);
+
+    // parsing newline-aligned chunks of a mapped csv file on several threads
+    // (num_threads = 0 uses every available core)
+    bool loadArtistsFromCSVParallel(const string& filename, ArtistDatabase& artists, unsigned num_threads = 0);
+    bool loadSongsFromCSVParallel(const string& filename, SongDatabase& songs, unsigned num_threads = 0);
+
+    // binary catalog snapshots: written once, then opened via mmap without parsing;
+    // the catalog's clustering and built indexes travel with it when given / present
+    // (`indexes` comes back empty when the blob cannot apply to this process)
+    bool saveSnapshot(const string& filename, const ArtistDatabase& artists, const SongDatabase& songs,
+                      const ClusterAssignments* clusters = nullptr, const string* indexes = nullptr);
+    bool loadFromSnapshot(const string& filename, ArtistDatabase& artists, SongDatabase& songs,
+                          ClusterAssignments* clusters = nullptr, string* indexes = nullptr);
+
+    // applying append-only change files (op,<regular csv columns> with op = upsert|delete).
+    // Only rows appended since the previous call for the same file are applied.
+    bool applyArtistDelta(const string& filename, ArtistDatabase& artists, DeltaResult& result);
+    bool applySongDelta(const string& filename, SongDatabase& songs, DeltaResult& result);
+
+    // loading data from json files, streamed through a SAX parser:
+    // {"artists": [{"id", "name", "genre", "popularity_score", "tags": [...]}],
+    //  "songs":   [{"id", "name", "artist_id", "popularity_score", "features": [...]}]}
     bool loadFromJSON(const string& filename, ArtistDatabase& artists, SongDatabase& songs);
 
-    // validating the loaded data
-    bool validateData(const ArtistDatabase& artists, const SongDatabase& songs);
+    // validating the loaded data in one parallel pass (num_threads = 0 uses every core);
+    // details are available from getLastValidationReport(). Song artist refs are
+    // taken from the store's resolved artist column when it covers `songs`.
+    // Parse errors and duplicate ids noted by loads since the previous
+    // validation are reported once, then the logs start over.
+    bool validateData(const ArtistDatabase& artists, const SongDatabase& songs, const SongStore* store = nullptr);
+    bool validateData(const ArtistDatabase& artists, const SongDatabase& songs, const SongStore* store,
+                      unsigned num_threads);
+    const ValidationReport& getLastValidationReport() const { return last_report_; }
+
+    // load-time report for the last load call
+    const LoadStats& getLastLoadStats() const { return last_stats_; }
+    void printLoadStats(const string& label) const;
 
 private:
+    LoadStats last_stats_;
+    map<string, size_t> delta_offsets_; // change file -> bytes already applied
+    DuplicateLog artist_duplicates_;
+    DuplicateLog song_duplicates_;
+    ParseErrors parse_errors_; // accumulated by the loads since the last validation
+    size_t rejected_ids_ = 0;  // records skipped for an empty id, likewise
+    ValidationReport last_report_;
+
     // helper methods and functions for parsing
 
     Artist parseArtistFromCSV(const string& line);
     Song parseSongFromCSV(const string& line);
-};
\ No newline at end of file
+
+    // parsing one tokenized record, starting at column `first`
+    void parseArtistRecord(const vector<CsvField>& fields, size_t first, CsvTokenizer& tokenizer, Artist& artist);
+    void parseSongRecord(const vector<CsvField>& fields, size_t first, CsvTokenizer& tokenizer, Song& song);
+};
@@ -1,26 +1,61 @@
 #pragma once
 #include "types.h"
+#include "song_store.h"
+#include "feature_vec.h"
+#include "tag_bitsets.h"
+#include "feature_stats.h"
 #include <vector>
 #include <string>
 using namespace std;
 
+// Artist features are always genre, popularity, tag count, genre diversity, underground
+constexpr size_t kArtistFeatureDims = 5;
+using ArtistFeatures = FeatureVec<kArtistFeatureDims>;
+static_assert(sizeof(ArtistFeatures) == kArtistFeatureDims * sizeof(double), "artist feature rows must be packed");
+
 class FeatureExtractor {
 public:
     // Extract features from artists and songs
+    ArtistFeatures extractArtistFeatureVec(const Artist& artist); // normalized, no heap allocation
+    // same, with the artist's distinct tag count supplied (e.g. a TagBitsets popcount)
+    ArtistFeatures extractArtistFeatureVec(const Artist& artist, size_t distinct_tags);
+    // the raw values before normalization (genre code 0 - 20, the rest 0 - 1)
+    ArtistFeatures extractRawArtistFeatures(const Artist& artist, size_t distinct_tags);
+    ArtistFeatures extractRawArtistFeatures(const Artist& artist);
     vector<double> extractArtistFeatures(const Artist& artist);
     vector<double> extractSongFeatures(const Song& song);
+    vector<double> extractSongFeatures(const SongStore& store, DenseId row);
+    
+    // Batch extraction into caller-provided rows, normalized as they are written.
+    // Row i holds the features of ids[i] (zeros when that id is not live); ranges
+    // of rows are extracted on up to `threads` workers (0 = all cores).
+    // With `tags`, tag diversity is read from its popcounts; with `stats`, artist
+    // rows are z-scored against them before the L2 step (one fused pass).
+    void extractArtistFeatures(const ArtistDatabase& artists, const vector<DenseId>& ids,
+                               ArtistFeatures* out, const TagBitsets* tags = nullptr,
+                               const FeatureStats* stats = nullptr, unsigned threads = 0);
+    void extractRawArtistFeatures(const ArtistDatabase& artists, const vector<DenseId>& ids,
+                                  ArtistFeatures* out, const TagBitsets* tags = nullptr, unsigned threads = 0);
+    // Song rows are `width` doubles: the row's features, zeros, then popularity
+    // and underground factor in the last two columns (features past width - 2
+    // are dropped)
+    void extractSongFeatures(const SongStore& store, const vector<DenseId>& rows,
+                             double* out, size_t width, unsigned threads = 0);
     
     // Normalize feature vectors
     vector<double> normalizeFeatures(const vector<double>& features);
+    void normalizeInPlace(vector<double>& features);
     
     // Get feature names for debugging
     vector<string> getFeatureNames() const;
 
 private:
     // Helper methods for specific feature extraction
-    double extractGenreFeatures(const string& genre);
+    double extractGenreFeatures(GenreCode genre);
     double extractPopularityFeatures(double popularity_score);
-    double extractTagFeatures(const vector<string>& tags);
-    double extractGenreDiversity(const vector<string>& tags);
+    double extractTagFeatures(const vector<Symbol>& tags);
+    double extractGenreDiversity(size_t distinct_tags);
+    size_t countDistinctTags(const vector<Symbol>& tags);
     double extractUndergroundFactor(double popularity_score);
+    void finishSongFeatures(vector<double>& features, double popularity_score);
 };
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+#include "index_blob.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+using namespace std;
+
+// Per-dimension mean and variance of feature rows, kept with Welford's
+// running update so rows can be added and removed one at a time (delta
+// ingestion) without rescanning the catalog. Partial results from separate
+// ranges combine exactly with merge(), which makes the full pass parallel.
+class FeatureStats {
+public:
+    explicit FeatureStats(size_t dims = 0);
+
+    // statistics of `count` row-major rows of `dims` values; rows whose `live`
+    // flag is 0 are skipped (no mask = every row). Ranges are reduced on up to
+    // `threads` workers (0 = all cores) and merged.
+    static FeatureStats compute(const double* rows, size_t count, size_t dims,
+                                const uint8_t* live = nullptr, unsigned threads = 0);
+
+    void add(const double* row);
+    void remove(const double* row); // inverse of add() for a row added earlier
+    void merge(const FeatureStats& other);
+
+    void save(BlobWriter& out) const;
+    bool load(BlobReader& in); // same dims() as this
+
+    size_t dims() const { return mean_.size(); }
+    size_t count() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    double mean(size_t d) const { return mean_[d]; }
+    double variance(size_t d) const; // population variance
+
+    // Fused z-score + L2: every dimension is centered and scaled to unit
+    // variance (constant dimensions become 0), then the row is scaled to unit
+    // length. Rows are dims() wide; with no rows counted yet only the L2 step
+    // runs. `in` may equal `out`.
+    void standardize(const double* in, double* out) const;
+
+private:
+    size_t count_ = 0;
+    vector<double> mean_;
+    vector<double> m2_; // sum of squared deviations from the mean
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+using namespace std;
+
+// Expand fn(integral_constant<size_t, I>) for I = 0..D-1 at compile time
+template <size_t D, typename Fn, size_t... I>
+inline void unrollImpl(Fn&& fn, index_sequence<I...>) {
+    (fn(integral_constant<size_t, I>{}), ...);
+}
+
+template <size_t D, typename Fn>
+inline void unroll(Fn&& fn) {
+    unrollImpl<D>(std::forward<Fn>(fn), make_index_sequence<D>{});
+}
+
+// Fixed-length kernels over raw rows (double accumulation, any element type)
+template <size_t D, typename A, typename B>
+inline double fixedDot(const A* a, const B* b) {
+    double sum = 0.0;
+    unroll<D>([&](auto i) { sum += static_cast<double>(a[i]) * static_cast<double>(b[i]); });
+    return sum;
+}
+
+template <size_t D, typename A, typename B>
+inline double fixedSquaredDistance(const A* a, const B* b) {
+    double sum = 0.0;
+    unroll<D>([&](auto i) {
+        double diff = static_cast<double>(a[i]) - static_cast<double>(b[i]);
+        sum += diff * diff;
+    });
+    return sum;
+}
+
+// Feature vector whose dimension is known at compile time; lives on the stack
+template <size_t D>
+struct FeatureVec {
+    array<double, D> values{};
+
+    static constexpr size_t size() { return D; }
+    double& operator[](size_t i) { return values[i]; }
+    double operator[](size_t i) const { return values[i]; }
+    const double* data() const { return values.data(); }
+    double* data() { return values.data(); }
+
+    double dot(const FeatureVec& other) const { return fixedDot<D>(data(), other.data()); }
+    double norm() const { return sqrt(dot(*this)); }
+    double distance(const FeatureVec& other) const { return sqrt(fixedSquaredDistance<D>(data(), other.data())); }
+
+    // scale to unit length in place (left unchanged when ~0, like FeatureExtractor::normalizeFeatures)
+    void normalize() {
+        double magnitude = norm();
+        if (magnitude < 1e-10) return;
+        unroll<D>([&](auto i) { values[i] /= magnitude; });
+    }
+
+    vector<double> toVector() const { return vector<double>(values.begin(), values.end()); }
+};
+
+// Row-major matrix of fixed-dimension rows: FeatureVec<D> is a plain array,
+// so the rows sit back to back in one allocation
+template <size_t D>
+using FeatureMatrix = vector<FeatureVec<D>>;
+
+// Largest dimension with a compiled instantiation
+constexpr size_t kMaxFixedDims = 8;
+
+// Call fn(integral_constant<size_t, D>) for a runtime dims in [1, kMaxFixedDims];
+// returns false (fn not called) for other sizes so callers can fall back
+template <typename Fn>
+inline bool dispatchFeatureDims(size_t dims, Fn&& fn) {
+    switch (dims) {
+        case 1: fn(integral_constant<size_t, 1>{}); return true;
+        case 2: fn(integral_constant<size_t, 2>{}); return true;
+        case 3: fn(integral_constant<size_t, 3>{}); return true;
+        case 4: fn(integral_constant<size_t, 4>{}); return true;
+        case 5: fn(integral_constant<size_t, 5>{}); return true;
+        case 6: fn(integral_constant<size_t, 6>{}); return true;
+        case 7: fn(integral_constant<size_t, 7>{}); return true;
+        case 8: fn(integral_constant<size_t, 8>{}); return true;
+        default: return false;
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <string_view>
+#include <cstdint>
+using namespace std;
+
+// Primary genres known to the feature encoder. The value is also the genre's
+// feature encoding, so these numbers must not change.
+enum class GenreCode : uint8_t {
+    Unknown = 0,
+    HipHop = 1,       // hip-hop, rap
+    Pop = 2,
+    Rock = 3,
+    Electronic = 4,   // electronic, edm
+    RnB = 5,          // r&b, soul
+    Indie = 6,        // indie, alternative
+    Jazz = 7,
+    Classical = 8,
+    Country = 9,
+    Folk = 10,
+    Metal = 11,
+    Punk = 12,
+    Reggae = 13,
+    Blues = 14,
+    Funk = 15,
+    Disco = 16,
+    Latin = 17,
+    World = 18,
+    Experimental = 19,
+    Ambient = 20,
+};
+
+// Map a genre as written in the data to its code. Case, spaces, '-', '_', '/'
+// and '.' are ignored, so "Hip-Hop", "hip hop" and "HIPHOP" all match; lookup is
+// one hash into a compile-time perfect hash table and one compare.
+// Called once per record at ingest; the result lives on Artist::genre_code.
+GenreCode encodeGenre(string_view genre);
+
+// canonical name of a code ("unknown" for Unknown)
+const char* genreName(GenreCode code);
@@ -0,0 +1,89 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+using namespace std;
+
+// Flat binary form of built indexes, persisted next to the catalog in a
+// snapshot so a restart copies them back instead of rebuilding them.
+//
+// Values and arrays of trivially copyable types are written as raw native
+// bytes (arrays with a uint64 count first). Reads are bounds checked; the
+// first failed read leaves the reader failed, so a load() can read everything
+// and check ok() once at the end.
+class BlobWriter {
+public:
+    template <typename T>
+    void value(const T& item) {
+        static_assert(is_trivially_copyable<T>::value, "blob values are raw bytes");
+        out_.append(reinterpret_cast<const char*>(&item), sizeof(T));
+    }
+
+    template <typename T, typename Allocator>
+    void array(const vector<T, Allocator>& items) {
+        static_assert(is_trivially_copyable<T>::value, "blob arrays are raw bytes");
+        value<uint64_t>(items.size());
+        out_.append(reinterpret_cast<const char*>(items.data()), items.size() * sizeof(T));
+    }
+
+    void text(string_view item) {
+        value<uint64_t>(item.size());
+        out_.append(item.data(), item.size());
+    }
+
+    const string& bytes() const { return out_; }
+    string release() { return std::move(out_); }
+
+private:
+    string out_;
+};
+
+class BlobReader {
+public:
+    explicit BlobReader(string_view bytes) : bytes_(bytes) {}
+
+    template <typename T>
+    bool value(T& item) {
+        static_assert(is_trivially_copyable<T>::value, "blob values are raw bytes");
+        if (!take(sizeof(T))) return false;
+        memcpy(&item, bytes_.data() + position_ - sizeof(T), sizeof(T));
+        return true;
+    }
+
+    template <typename T, typename Allocator>
+    bool array(vector<T, Allocator>& items) {
+        static_assert(is_trivially_copyable<T>::value, "blob arrays are raw bytes");
+        uint64_t count = 0;
+        if (!value(count) || count > remaining() / sizeof(T)) return fail();
+        items.resize(count);
+        if (count != 0) memcpy(items.data(), bytes_.data() + position_, count * sizeof(T));
+        position_ += count * sizeof(T);
+        return true;
+    }
+
+    bool text(string& item) {
+        uint64_t length = 0;
+        if (!value(length) || !take(length)) return fail();
+        item.assign(bytes_.data() + position_ - length, length);
+        return true;
+    }
+
+    bool ok() const { return ok_; }
+    bool atEnd() const { return ok_ && position_ == bytes_.size(); }
+    bool fail() { return ok_ = false; }
+
+private:
+    string_view bytes_;
+    size_t position_ = 0;
+    bool ok_ = true;
+
+    size_t remaining() const { return bytes_.size() - position_; }
+    bool take(uint64_t count) {
+        if (!ok_ || count > remaining()) return fail();
+        position_ += count;
+        return true;
+    }
+};
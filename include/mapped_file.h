@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstddef>
+using namespace std;
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // map / unmap the file
+    bool open(const string& filename);
+    void close();
+
+    // access to the mapped bytes
+    bool isOpen() const { return is_open_; }
+    const char* data() const { return static_cast<const char*>(data_); }
+    size_t size() const { return size_; }
+    string_view view() const { return string_view(data(), size_); }
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    bool is_open_ = false;
+};
@@ -1,7 +1,9 @@
 #pragma once
 #include "types.h"
+#include "song_store.h"
+#include "feature_extractor.h"
+#include "cow_ptr.h"
 #include <vector>
-#include <map>
 #include <random>
 using namespace std;
 
@@ -11,33 +13,55 @@ public:
     // Constructor
     MLEnhancer(int num_clusters = 8);
     
-    // Train the model with artist/song data
-    void trainArtistModel(const vector<Artist>& artists);
-    void trainSongModel(const vector<Song>& songs);
+    // Train the model with artist/song data (songs are streamed from the song store).
+    // Artist features are standardized with `stats` when they describe this
+    // catalog, otherwise with statistics computed here; either way they are kept
+    // with the model. `saved` assignments for the same items and k replace the
+    // k-means run; centroids are recomputed from them.
+    void trainArtistModel(const ArtistDatabase& artists, const FeatureStats* stats = nullptr,
+                          const ClusterAssignments* saved = nullptr);
+    void trainSongModel(const SongStore& songs, const ClusterAssignments* saved = nullptr);
     
-    // Get enhanced recommendations
+    // the trained clustering in snapshot order (clusters == 0 unless every live item is assigned)
+    ClusterAssignments exportClusters(const ArtistDatabase& artists, const SongStore& songs) const;
+    
+    // the trained models (centroids, assignments, points), for a catalog
+    // snapshot; load() needs the same number of clusters
+    void save(BlobWriter& out) const;
+    bool load(BlobReader& in);
+    
+    // Incremental updates without retraining: changed items are assigned to their
+    // nearest centroid and centroids move by running-mean updates
+    void updateArtists(const ArtistDatabase& artists, const vector<DenseId>& upserted,
+                       const vector<DenseId>& removed);
+    void updateSongs(const SongStore& songs, const vector<DenseId>& upserted,
+                     const vector<DenseId>& removed);
+    
+    // Get enhanced recommendations (results are matched by item_id)
     vector<RecommendationResult> enhanceArtistRecommendations(
         const vector<RecommendationResult>& base_recommendations,
-        const Artist& input_artist,
-        const ArtistDatabase& artists
+        const Artist& input_artist
     );
     
+    // the seed is read from `songs` at `input_row`, like the training rows
     vector<RecommendationResult> enhanceSongRecommendations(
         const vector<RecommendationResult>& base_recommendations,
-        const Song& input_song,
-        const SongDatabase& songs
+        const SongStore& songs, DenseId input_row
     );
     
-    // Get cluster information
-    int getArtistCluster(const Artist& artist) const;
-    int getSongCluster(const Song& song) const;
-    vector<Artist> getArtistsInCluster(int cluster_id) const;
-    vector<Song> getSongsInCluster(int cluster_id) const;
+    // Get cluster information (-1 = not assigned)
+    int getArtistCluster(DenseId artist) const;
+    int getSongCluster(DenseId song) const;
+    vector<DenseId> getArtistsInCluster(int cluster_id) const;
+    vector<DenseId> getSongsInCluster(int cluster_id) const;
     
     // Model information
     bool isArtistModelTrained() const { return artist_model_trained_; }
     bool isSongModelTrained() const { return song_model_trained_; }
     int getNumClusters() const { return num_clusters_; }
+    // per-dimension artist statistics the model was trained with; fixed until the
+    // next training so that new points stay comparable with the centroids
+    const FeatureStats& getArtistStats() const { return artist_stats_; }
 
 private:
     int num_clusters_;
@@ -47,24 +71,32 @@ private:
     // K-means centroids
     vector<vector<double>> artist_centroids_;
     vector<vector<double>> song_centroids_;
+    vector<size_t> artist_cluster_sizes_;
+    vector<size_t> song_cluster_sizes_;
     
-    // Cluster assignments
-    map<string, int> artist_clusters_;  // artist_id -> cluster
-    map<string, int> song_clusters_;    // song_id -> cluster
+    // Cluster assignments by dense id (per-item state is copy-on-write, so a
+    // model copied for an update clones only the side it changes)
+    CowPtr<vector<int>> artist_clusters_;
+    CowPtr<vector<int>> song_clusters_;
     
-    // Training data
-    vector<Artist> training_artists_;
-    vector<Song> training_songs_;
+    // Feature rows of the clustered items by dense id, so an update can take an
+    // item's old contribution out of its centroid; one row-major matrix each
+    // (kArtistFeatureDims / song_width_ values per row, zero when unassigned)
+    CowPtr<vector<double>> artist_points_;
+    CowPtr<vector<double>> song_points_;
+    size_t song_width_ = 0; // song feature row width the model was trained with
+    FeatureStats artist_stats_{kArtistFeatureDims};
     
     // Helper methods
-    vector<vector<double>> extractArtistFeatures(const vector<Artist>& artists);
-    vector<vector<double>> extractSongFeatures(const vector<Song>& songs);
+    vector<double> extractArtistFeatures(const Artist& artist); // standardized with artist_stats_
+    // songs' features, batch-extracted into one row-major matrix (row i = rows[i])
+    vector<double> extractSongFeatures(const SongStore& songs, const vector<DenseId>& rows, size_t width);
+    vector<int> kmeansClustering(const vector<double>& data, size_t width, int k);
     vector<int> kmeansClustering(const vector<vector<double>>& data, int k);
     double calculateDistance(const vector<double>& point1, const vector<double>& point2);
     vector<double> calculateCentroid(const vector<vector<double>>& cluster_points);
     int findNearestCentroid(const vector<double>& point, const vector<vector<double>>& centroids);
     
-    // Random number generation
-    random_device rd_;
+    // Random number generation (seeded once; the model stays copyable)
     mt19937 gen_;
 }; 
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include "catalog.h"
+#include "index_blob.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+using namespace std;
+
+// Hash index from a normalized (case-folded, whitespace-collapsed) name to the
+// dense ids of every record carrying it. Names are not unique, so lookups
+// return all matches in ascending id order.
+class NameIndex {
+public:
+    NameIndex() = default;
+    NameIndex(const NameIndex& other) { *this = other; }
+    NameIndex& operator=(const NameIndex& other);   // re-points name_of_ at the copied keys
+    NameIndex(NameIndex&&) = default;               // moved nodes keep their addresses
+    NameIndex& operator=(NameIndex&&) = default;
+
+    // "  Sicko   MODE " -> "sicko mode" (ASCII case folding; other bytes kept as is)
+    static string normalize(string_view name);
+
+    template <typename Database>
+    void build(const Database& db) {
+        clear();
+        name_of_.resize(db.idBound(), nullptr);
+        for (auto it = db.begin(); it != db.end(); ++it) add(it.id(), it->name);
+    }
+
+    // re-index changed records (upserted ids may carry a new name)
+    template <typename Database>
+    void update(const Database& db, const vector<DenseId>& upserted, const vector<DenseId>& deleted) {
+        if (name_of_.size() < db.idBound()) name_of_.resize(db.idBound(), nullptr);
+        for (DenseId id : deleted) remove(id);
+        for (DenseId id : upserted) {
+            remove(id);
+            if (db.contains(id)) add(id, db[id].name);
+        }
+    }
+
+    // every id whose name normalizes to the same key (empty when none)
+    const vector<DenseId>& find(string_view name) const;
+    // the normalized name the id is indexed under (null when not indexed)
+    const string* keyOf(DenseId id) const { return id < name_of_.size() ? name_of_[id] : nullptr; }
+
+    size_t idBound() const { return name_of_.size(); }
+    size_t distinctNames() const { return ids_by_name_.size(); }
+    void clear();
+
+    // keys and id lists as built, for a catalog snapshot (no names are normalized on
+    // load); load() fails unless the index was saved for `id_bound` ids
+    void save(BlobWriter& out) const;
+    bool load(BlobReader& in, size_t id_bound);
+
+private:
+    unordered_map<string, vector<DenseId>> ids_by_name_;
+    vector<const string*> name_of_; // dense id -> its key in ids_by_name_ (node keys never move)
+
+    void add(DenseId id, const string& name);
+    void remove(DenseId id);
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+using namespace std;
+
+// Record id packed into 16 bytes.
+//
+// Spotify ids are 22 base62 characters encoding a 128-bit value, stored here as
+// two 64-bit words, so ids hash and compare as integers. Two values of the high
+// word are reserved (no real Spotify id reaches them) to tag the fallbacks:
+//   - numeric ids ("42", as in our CSV files): high = kNumericTag, low = the number
+//   - anything else, including "": high = kOtherTag, low = index in an interning pool
+// Every form converts back to the exact original text with str().
+class PackedId {
+public:
+    enum class Kind : uint8_t { Base62, Numeric, Other };
+
+    static constexpr size_t kBase62Length = 22;
+    static constexpr uint64_t kNumericTag = ~uint64_t(0);
+    static constexpr uint64_t kOtherTag = ~uint64_t(0) - 1;
+
+    PackedId() = default; // the empty id
+
+    // pack any id text (ids that are neither base62 nor numeric are interned);
+    // for ids that are about to be stored
+    static PackedId parse(string_view text);
+
+    // pack without interning, for ids that are only looked up or deleted; false
+    // when the text is an Other id that was never interned (so nothing carries it)
+    static bool find(string_view text, PackedId& id);
+
+    // strict base62 decode: 22 characters of [0-9a-zA-Z] below 2^128
+    static bool fromBase62(string_view text, PackedId& id);
+
+    string str() const;
+    Kind kind() const;
+    bool empty() const { return high_ == kOtherTag && low_ == 0; }
+
+    uint64_t high() const { return high_; }
+    uint64_t low() const { return low_; }
+
+    bool operator==(const PackedId& other) const { return high_ == other.high_ && low_ == other.low_; }
+    bool operator!=(const PackedId& other) const { return !(*this == other); }
+    bool operator<(const PackedId& other) const {
+        return high_ != other.high_ ? high_ < other.high_ : low_ < other.low_;
+    }
+
+    size_t hash() const {
+        uint64_t h = (high_ ^ (low_ * 0x9e3779b97f4a7c15ull)) * 0xbf58476d1ce4e5b9ull;
+        return static_cast<size_t>(h ^ (h >> 31));
+    }
+
+    // raw words, e.g. for binary snapshots (Other ids are only valid within this process)
+    static PackedId fromWords(uint64_t high, uint64_t low) { return PackedId(high, low); }
+
+private:
+    uint64_t high_ = kOtherTag;
+    uint64_t low_ = 0;
+
+    PackedId(uint64_t high, uint64_t low) : high_(high), low_(low) {}
+
+    static bool packInline(string_view text, PackedId& id);
+};
+
+namespace std {
+template <>
+struct hash<PackedId> {
+    size_t operator()(const PackedId& id) const { return id.hash(); }
+};
+} // namespace std
@@ -1,10 +1,30 @@
 #pragma once
 #include "types.h"
 #include "similarity_calculator.h"
+#include "feature_extractor.h"
 #include "popularity_adjuster.h"
 #include "ml_enhancer.h"
+#include "columnar_catalog.h"
+#include "song_store.h"
+#include "name_index.h"
+#include "search_index.h"
+#include "artist_song_index.h"
+#include "tag_bitsets.h"
+#include "tag_index.h"
+#include "cow_ptr.h"
 using namespace std;
 
+// Song rankings from the reduced-precision song store vs. the double-precision
+// path over Song records, for a sample of query songs
+struct PrecisionReport {
+    FeaturePrecision precision = FeaturePrecision::Float32;
+    size_t queries = 0;
+    size_t top_k = 0;
+    double max_score_error = 0.0;   // largest |store score - double score|
+    size_t max_rank_shift = 0;      // largest rank change of a song in a double top-k
+    double min_top_k_overlap = 1.0; // smallest share of the double top-k kept by the store
+};
+
 class RecommendationEngine {
 public:
     // Constructor
@@ -17,27 +37,114 @@ public:
     
     RecommendationList recommendSimilarSongs(const string& song_title,
                                             const SongDatabase& songs,
-                                            const ArtistDatabase& artists,
                                             int num_recommendations = 10);
     
+    // Same recommendation, named from a columnar catalog: scoring still runs on
+    // the song store, only the results' rows read the names column.
+    // Rows must match the song store's dense ids.
+    RecommendationList recommendSimilarSongs(const string& song_title,
+                                            const ColumnarCatalog& catalog,
+                                            int num_recommendations = 10);
+    
+    // Other songs by the seed song's artist, most similar to the seed first
+    // (reads the artist's slice of the artist->songs index, not the whole catalog)
+    RecommendationList recommendMoreByArtist(const string& song_title,
+                                             const SongDatabase& songs,
+                                             const ArtistDatabase& artists,
+                                             int num_recommendations = 10);
+    
+    // Artists sharing the seed artist's rarest tags (TF-IDF cosine); reads only
+    // the posting lists of the seed's tags, not the whole catalog
+    RecommendationList recommendArtistsByRareTags(const string& artist_name,
+                                                  const ArtistDatabase& artists,
+                                                  int num_recommendations = 10);
+    
     // Set engine parameters
     void setSimilarityThreshold(double threshold);
     void setMaxPopularity(double max_popularity);
+    void setTagWeight(double weight); // share of the tag Jaccard in the artist score (0 - 1)
     void enableML(bool enable = true);
+    // parameters and song store precision of another engine (no indexes or models)
+    void copySettings(const RecommendationEngine& other);
     
-    // ML training
-    void trainMLModels(const ArtistDatabase& artists, const SongDatabase& songs);
+    // (Re)build the name and search indexes and the song store used for song scans
+    // for catalog version `version`; call after a full (re)load. Queries never
+    // rebuild: they must be given the version the indexes were built for.
+    void indexCatalog(const ArtistDatabase& artists, const SongDatabase& songs, uint64_t version);
+    uint64_t catalogVersion() const { return catalog_version_; } // 0 before indexCatalog
+    
+    // Every index and the ML models as one blob, persisted with a catalog
+    // snapshot (empty while delta patches are pending: save right after a full
+    // build). loadIndexes() takes it instead of indexCatalog() + trainMLModels()
+    // when it was saved for catalogs of the same shape, with the same Symbols;
+    // on false the engine must be built as usual.
+    string saveIndexes() const;
+    bool loadIndexes(string_view blob, const ArtistDatabase& artists, const SongDatabase& songs, uint64_t version);
+    const SongStore& getSongStore() const { return *song_store_; }
+    const ArtistSongIndex& getArtistSongs() const { return *artist_songs_; }
+    const TagBitsets& getArtistTags() const { return *artist_tags_; }
+    const FeatureStats& getArtistStats() const { return artist_stats_; }
+    
+    // Rebuild the song store in another precision, and measure how far its
+    // song rankings drift from the double-precision ones
+    void setFeaturePrecision(FeaturePrecision precision, const ArtistDatabase& artists, const SongDatabase& songs);
+    PrecisionReport checkFeaturePrecision(const SongDatabase& songs, size_t queries = 100, size_t top_k = 10);
+    
+    // Exact (case-folded) name lookups and typeahead suggestions for partial or misspelled names
+    bool hasArtist(const string& name) const { return !artist_names_->find(name).empty(); }
+    bool hasSong(const string& title) const { return !song_names_->find(title).empty(); }
+    vector<SearchHit> suggestArtists(const string& query, size_t limit = SearchIndex::kDefaultLimit) const;
+    vector<SearchHit> suggestSongs(const string& query, size_t limit = SearchIndex::kDefaultLimit) const;
+    
+    // ML training (`saved`: a clustering persisted with this catalog, used instead of k-means when it fits)
+    void trainMLModels(const ArtistDatabase& artists, const SongDatabase& songs,
+                       const ClusterAssignments* saved = nullptr);
+    ClusterAssignments exportClusters(const ArtistDatabase& artists) const;
+    
+    // Incremental updates after delta ingestion (no retraining); `version` is the
+    // catalog version the deltas produced
+    void updateArtists(const ArtistDatabase& artists, const SongDatabase& songs,
+                       const vector<DenseId>& upserted_ids, const vector<DenseId>& deleted_ids,
+                       uint64_t version);
+    void updateSongs(const SongDatabase& songs, const ArtistDatabase& artists,
+                     const vector<DenseId>& upserted_ids, const vector<DenseId>& deleted_ids,
+                     uint64_t version);
 
 private:
     SimilarityCalculator similarity_calc_;
+    FeatureExtractor feature_extractor_;
     PopularityAdjuster popularity_adjuster_;
     MLEnhancer ml_enhancer_;
+    // Indexes are shared copy-on-write: an engine copied for the next catalog
+    // version shares them with the published one and clones only those its
+    // update writes (a song delta leaves every artist index shared)
+    CowPtr<SongStore> song_store_;
+    CowPtr<ArtistSongIndex> artist_songs_;
+    CowPtr<FeatureMatrix<kArtistFeatureDims>> artist_features_; // z-scored + normalized, by artist dense id (zero when erased)
+    CowPtr<FeatureMatrix<kArtistFeatureDims>> artist_raw_features_; // before standardization, same rows
+    CowPtr<vector<uint8_t>> artist_counted_;                    // rows included in artist_stats_
+    FeatureStats artist_stats_{kArtistFeatureDims};
+    CowPtr<TagBitsets> artist_tags_;
+    CowPtr<TagIndex> artist_tag_index_;
+    CowPtr<NameIndex> artist_names_;
+    CowPtr<NameIndex> song_names_;
+    CowPtr<SearchIndex> artist_search_;
+    CowPtr<SearchIndex> song_search_;
+    
+    uint64_t catalog_version_ = 0; // catalog version the indexes below were built for
     
     double similarity_threshold_ = 0.1;
     double max_popularity_ = 0.8;
+    double tag_weight_ = 0.2;
     bool ml_enabled_ = true;
     
     // Helper methods
     RecommendationList filterAndRank(const vector<RecommendationResult>& candidates);
+    void cacheArtistFeatures(const ArtistDatabase& artists);
+    void refreshArtistFeatures(const ArtistDatabase& artists, const vector<DenseId>& upserted_ids,
+                               const vector<DenseId>& deleted_ids);
+    void standardizeArtistFeatures();
+    RecommendationList rankSimilarSongs(DenseId input_id, int num_recommendations);
+    DenseId pickSeed(const vector<DenseId>& matches, const string& name, const string& kind);
     bool meetsPopularityCriteria(double popularity_score);
 };
\ No newline at end of file
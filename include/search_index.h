@@ -0,0 +1,112 @@
+#pragma once
+#include "index_blob.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+using namespace std;
+
+// One completion or fuzzy match
+struct SearchHit {
+    string name;          // display name (first record seen with this normalized name)
+    double score = 0.0;   // highest popularity among the records with this name
+    double match = 1.0;   // 1.0 for prefix matches, trigram similarity for fuzzy ones
+    size_t records = 0;   // records sharing the name
+};
+
+// Typeahead index over the names of one catalog (artists or songs).
+//
+// Distinct normalized names are kept sorted in one string pool, so a prefix
+// is a contiguous range found by binary search; the best-scored names in that
+// range come out of a block-max sparse table without visiting the whole range.
+// Misspellings are matched through trigram posting lists, rarest trigrams
+// first, ranked by Dice similarity.
+//
+// Catalog deltas are patched in without re-sorting: the touched names are
+// masked in the base index and served from a small overlay index over just
+// those names, merged into every result. The owner folds the overlay into a
+// full build() once overlayFull().
+class SearchIndex {
+public:
+    static constexpr size_t kDefaultLimit = 10;
+
+    // index record.name, ranked by record.popularity_score
+    template <typename Database>
+    void build(const Database& db) {
+        vector<pair<string_view, double>> names;
+        names.reserve(db.size());
+        for (const auto& record : db) names.emplace_back(record.name, record.popularity_score);
+        build(names);
+    }
+    void build(const vector<pair<string_view, double>>& names);
+
+    // replace everything indexed under the names `touched` (normalized or not)
+    // with `records`: every record that now carries one of those names
+    void patch(const vector<string>& touched, const vector<pair<string_view, double>>& records);
+    size_t patchedNames() const { return patched_.size(); }
+    bool overlayFull() const { return patched_.size() > max(kMinOverlay, size() / 8); }
+
+    // best-scored names starting with `prefix` (normalized like NameIndex)
+    vector<SearchHit> complete(string_view prefix, size_t limit = kDefaultLimit) const;
+
+    // names sharing enough trigrams with `query` (tolerates typos), most similar first
+    vector<SearchHit> fuzzy(string_view query, size_t limit = kDefaultLimit, double min_similarity = 0.3) const;
+
+    // prefix completions, topped up with fuzzy matches
+    vector<SearchHit> suggest(string_view query, size_t limit = kDefaultLimit) const;
+
+    // the built base index, for a catalog snapshot; save() declines (false)
+    // while an overlay is pending
+    bool save(BlobWriter& out) const;
+    bool load(BlobReader& in);
+
+    size_t size() const { return scores_.size(); }
+    bool empty() const { return scores_.empty(); }
+    size_t memoryBytes() const;
+
+private:
+    static constexpr size_t kBlock = 64;            // entries per block of the range-max table
+    static constexpr size_t kMaxCandidates = 1 << 12; // fuzzy candidates gathered from rare trigrams
+    static constexpr size_t kMinOverlay = 256;        // patched names always allowed before a rebuild
+
+    // sorted distinct normalized names: keys_[offsets_[i], offsets_[i + 1]),
+    // display names likewise in names_
+    string keys_;
+    vector<uint64_t> offsets_;
+    string names_;
+    vector<uint64_t> name_offsets_;
+    vector<float> scores_;
+    vector<uint32_t> records_;
+    vector<uint16_t> trigram_counts_;
+
+    // range max: best entry of every block, then a sparse table over blocks
+    vector<vector<uint32_t>> block_table_;
+
+    // trigram -> entries (CSR, trigrams sorted, postings in entry order)
+    vector<uint32_t> trigrams_;
+    vector<uint64_t> posting_offsets_;
+    vector<uint32_t> postings_;
+
+    // delta overlay: patched normalized name -> its records (display name, score);
+    // their base entries are masked, the overlay indexes the records
+    unordered_map<string, vector<pair<string, float>>> patched_;
+    vector<uint8_t> masked_;
+    shared_ptr<const SearchIndex> overlay_; // immutable once built, so copies share it
+
+    string_view key(uint32_t entry) const {
+        return string_view(keys_.data() + offsets_[entry], offsets_[entry + 1] - offsets_[entry]);
+    }
+    uint32_t better(uint32_t a, uint32_t b) const { return scores_[b] > scores_[a] ? b : a; }
+    uint32_t bestInRange(uint32_t first, uint32_t last) const; // inclusive
+    uint32_t lowerBound(string_view key) const;                 // first entry not below `key`
+    bool masked(uint32_t entry) const { return !masked_.empty() && masked_[entry]; }
+    SearchHit hit(uint32_t entry, double match) const;
+    static vector<uint32_t> trigramsOf(string_view key);
+    // base-index results with the masked entries left out
+    vector<SearchHit> completeBase(string_view prefix, size_t limit) const;
+    vector<SearchHit> fuzzyBase(string_view query, size_t limit, double min_similarity) const;
+};
@@ -1,5 +1,7 @@
 #pragma once
 #include "types.h"
+#include "song_store.h"
+#include "feature_extractor.h"
 #include <vector>
 using namespace std;
 
@@ -10,12 +12,39 @@ public:
     double calculateCosineSimilarity(const vector<double>& vec1, const vector<double>& vec2);
     double calculateEuclideanDistance(const vector<double>& vec1, const vector<double>& vec2);
 
+    // fixed-dimension cosine (loops unroll at compile time)
+    template <size_t D>
+    double calculateCosineSimilarity(const FeatureVec<D>& vec1, const FeatureVec<D>& vec2) {
+        double magnitude1 = vec1.norm();
+        double magnitude2 = vec2.norm();
+        if(magnitude1 == 0 || magnitude2 == 0) return 0.0;
+        return vec1.dot(vec2) / (magnitude1 * magnitude2);
+    }
+
+    // cosine of two unit-length vectors (e.g. cached normalized features) is their dot product
+    template <size_t D>
+    double calculateNormalizedSimilarity(const FeatureVec<D>& unit1, const FeatureVec<D>& unit2) {
+        return unit1.dot(unit2);
+    }
+
     // calculating the similarity between two artists
     double calculateArtistSimilarity(const Artist& artist1, const Artist& artist2);
+    // same, with the first artist's features extracted once by the caller
+    double calculateArtistSimilarity(const ArtistFeatures& features1, const Artist& artist2);
 
     // calculatring the siilarity between two songs
     double calculateSongSimilarity(const Song& song1, const Song& song2);
 
+    // cosine similarity of `query` (store.stride() values) against every row of the
+    // store, streamed in row order; scores[row] is 0 for rows that are not live.
+    // Rows are read in the store's precision and accumulated in float32; the
+    // stride is dispatched once per call to a fixed-width kernel.
+    void calculateSongSimilarities(const SongStore& store, const float* query, vector<double>& scores);
+
+    // cosine similarity of `query` against one row of the store (0 when not live);
+    // same float32 kernel as the batch scan, so both score a pair identically
+    double calculateSongSimilarity(const SongStore& store, const float* query, DenseId row);
+
     // converting the distance into a similarity score between 0 and 1
     double distanceToSimilarity(double distance);
 
@@ -23,4 +52,5 @@ private:
     // helper methods/functions
     double dotProduct(const vector<double>& vec1, const vector<double>& vec2);
     double magnitude(const vector<double>& vec);
+    FeatureExtractor feature_extractor_;
 };
\ No newline at end of file
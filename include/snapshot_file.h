@@ -0,0 +1,149 @@
+#pragma once
+#include "types.h"
+#include "mapped_file.h"
+#include <string>
+#include <string_view>
+#include <cstdint>
+using namespace std;
+
+// Versioned binary catalog snapshot.
+//
+// Layout (native little-endian, every section 8-byte aligned):
+//   header | feature block (double) | artist records | song records | tags |
+//   artist clusters | song clusters (int32, only with a model) | symbols |
+//   indexes (optional) | string table
+//
+// Records are fixed width and refer to strings by (offset, length) into the
+// string table, so an opened snapshot is usable straight from the mapping.
+// Ids are stored packed (see PackedId); only ids of the Other kind, whose
+// packed form is local to a process, go through the string table.
+//
+// Genres and tags are numbers into the symbols section, which lists the
+// writer's SymbolTable in Symbol order: a load interns each distinct symbol
+// once, not every reference. The indexes section is an opaque blob of built
+// indexes (RecommendationEngine::saveIndexes) for exactly these records; it
+// is only usable when the load gives every symbol its old number back.
+namespace snapshot {
+
+constexpr char kMagic[8] = {'M', 'R', 'S', 'N', 'A', 'P', '\0', '\0'};
+constexpr uint32_t kVersion = 4;
+
+struct StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// PackedId words; for Other ids `low` holds the string ref (offset << 32 | length)
+struct IdRef {
+    uint64_t high;
+    uint64_t low;
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t artist_count;
+    uint64_t song_count;
+    uint64_t tag_count;
+    uint64_t feature_count;
+    uint64_t string_bytes;
+    uint64_t features_offset;
+    uint64_t artists_offset;
+    uint64_t songs_offset;
+    uint64_t tags_offset;
+    uint64_t strings_offset;
+    uint64_t model_clusters; // k of the persisted clustering, 0 = none
+    uint64_t artist_clusters_offset;
+    uint64_t song_clusters_offset;
+    uint64_t symbol_count;
+    uint64_t symbols_offset;  // symbol_count StringRefs
+    uint64_t index_bytes;     // 0 = no indexes
+    uint64_t index_offset;
+};
+
+struct ArtistRecord {
+    IdRef id;
+    StringRef name;
+    uint32_t genre;       // index into the symbols
+    uint32_t genre_code;  // GenreCode, as encoded at ingest
+    double popularity_score;
+    uint32_t tags_begin;  // index into the tags (uint32 symbol indexes)
+    uint32_t tags_count;
+};
+
+struct SongRecord {
+    IdRef id;
+    StringRef name;
+    IdRef artist_id;
+    double popularity_score;
+    uint64_t features_begin; // index into the feature block
+    uint32_t features_count;
+    uint32_t reserved;
+};
+
+} // namespace snapshot
+
+// Read-only views over records inside an opened snapshot
+struct ArtistView {
+    PackedId id;
+    string_view name;
+    uint32_t genre;  // snapshot symbol index, see SnapshotFile::symbol()
+    GenreCode genre_code;
+    double popularity_score;
+    const uint32_t* tags; // snapshot symbol indexes
+    size_t tag_count;
+};
+
+struct SongView {
+    PackedId id;
+    string_view name;
+    PackedId artist_id;
+    double popularity_score;
+    const double* features;
+    size_t feature_count;
+};
+
+class SnapshotFile {
+public:
+    // write a snapshot of the given catalog, with its clustering when `clusters`
+    // covers exactly the live artists and songs, and the `indexes` blob when
+    // given and non-empty (catalogs without tombstones only: a load renumbers)
+    static bool write(const string& filename, const ArtistDatabase& artists, const SongDatabase& songs,
+                      const ClusterAssignments* clusters = nullptr, const string* indexes = nullptr);
+
+    // map an existing snapshot; only the header is checked, nothing is parsed
+    bool open(const string& filename);
+    bool isOpen() const { return file_.isOpen(); }
+    size_t sizeBytes() const { return file_.size(); }
+
+    // record access straight from the mapping
+    size_t artistCount() const { return header_ ? header_->artist_count : 0; }
+    size_t songCount() const { return header_ ? header_->song_count : 0; }
+    ArtistView artist(size_t index) const;
+    SongView song(size_t index) const;
+    string_view str(const snapshot::StringRef& ref) const;
+    size_t symbolCount() const { return header_ ? header_->symbol_count : 0; }
+    string_view symbol(uint32_t index) const;
+    PackedId id(const snapshot::IdRef& ref) const;
+
+    // copy the snapshot into in-memory databases; true when every symbol was
+    // interned under the number it had in the writer, so indexes() apply
+    bool materialize(ArtistDatabase& artists, SongDatabase& songs) const;
+    // the persisted index blob (empty when the snapshot has none)
+    string_view indexes() const;
+    // the persisted clustering (clusters == 0 when the snapshot has none)
+    ClusterAssignments clusters() const;
+
+private:
+    MappedFile file_;
+    const snapshot::Header* header_ = nullptr;
+    const double* features_ = nullptr;
+    const snapshot::ArtistRecord* artists_ = nullptr;
+    const snapshot::SongRecord* songs_ = nullptr;
+    const uint32_t* tags_ = nullptr;
+    const snapshot::StringRef* symbols_ = nullptr;
+    const char* strings_ = nullptr;
+
+    bool validateLayout() const;
+};
@@ -0,0 +1,145 @@
+#pragma once
+#include "types.h"
+#include "index_blob.h"
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+using namespace std;
+
+// Element type of the song store's feature matrix
+enum class FeaturePrecision : uint8_t {
+    Float32,  // 4 bytes per feature, ~7 significant digits
+    BFloat16  // 2 bytes per feature: float32 with the mantissa cut to 8 bits (~2-3 digits)
+};
+
+// Compile-time default; build with -DSONG_FEATURES_BF16 to store bfloat16 unless
+// SongStore::setPrecision says otherwise
+#if defined(SONG_FEATURES_BF16)
+constexpr FeaturePrecision kDefaultFeaturePrecision = FeaturePrecision::BFloat16;
+#else
+constexpr FeaturePrecision kDefaultFeaturePrecision = FeaturePrecision::Float32;
+#endif
+
+const char* precisionName(FeaturePrecision precision);
+
+// float32 -> bfloat16, round to nearest even (NaN stays NaN)
+inline uint16_t toBFloat16(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u) return static_cast<uint16_t>((bits >> 16) | 0x40);
+    bits += 0x7fffu + ((bits >> 16) & 1u);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+// bfloat16 -> float32 is exact: the bits are the high half of a float
+inline float fromBFloat16(uint16_t value) {
+    uint32_t bits = static_cast<uint32_t>(value) << 16;
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// Allocator handing out memory aligned to `Alignment` bytes (cache line by default)
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), align_val_t(Alignment)));
+    }
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+// Structure-of-arrays copy of the song catalog for scans.
+//
+// Features sit in one 64-byte-aligned, row-major matrix with a fixed stride
+// (shorter vectors are zero padded), next to parallel popularity, norm and
+// artist index arrays. Row i belongs to song dense id i, so a scan walks
+// memory sequentially instead of chasing one heap block per song.
+//
+// The matrix holds float32 or bfloat16 values (precision()); only one of
+// matrix() / bf16Matrix() is populated. Norms are of the stored values.
+class SongStore {
+public:
+    static constexpr size_t kAlignment = 64;
+    static constexpr size_t kStrideMultiple = 4; // floats; keeps every row 16-byte aligned
+
+    using FloatVector = vector<float, AlignedAllocator<float, kAlignment>>;
+    using BFloat16Vector = vector<uint16_t, AlignedAllocator<uint16_t, kAlignment>>;
+
+    // storage precision for the next build(); an existing store keeps its own
+    void setPrecision(FeaturePrecision precision) { next_precision_ = precision; }
+    FeaturePrecision precision() const { return precision_; }
+
+    // copy every song (artist_id resolved against `artists`)
+    void build(const SongDatabase& songs, const ArtistDatabase& artists);
+
+    // refresh the rows of changed songs; returns false when a new feature count
+    // does not fit the stride (call build() instead)
+    bool update(const SongDatabase& songs, const ArtistDatabase& artists,
+                const vector<DenseId>& upserted, const vector<DenseId>& deleted);
+
+    void clear();
+
+    // the built store as raw arrays, for a catalog snapshot; load() takes only
+    // a store saved at the precision the next build() would use (a store of
+    // another precision is skipped, leaving `in` usable)
+    void save(BlobWriter& out) const;
+    bool load(BlobReader& in);
+
+    // rows == the song catalog's idBound(); rows of erased songs are not live
+    size_t rows() const { return popularity_.size(); }
+    size_t stride() const { return stride_; }
+    size_t liveCount() const { return live_count_; }
+    bool isLive(DenseId row) const { return row < rows() && live_[row]; }
+
+    const float* matrix() const { return features_.data(); }        // Float32 stores
+    const uint16_t* bf16Matrix() const { return bf16_features_.data(); } // BFloat16 stores
+    float feature(DenseId row, size_t d) const {
+        return precision_ == FeaturePrecision::Float32 ? features_[row * stride_ + d]
+                                                       : fromBFloat16(bf16_features_[row * stride_ + d]);
+    }
+    void copyFeatures(DenseId row, float* out) const; // stride() values, widened to float
+    size_t featureCount(DenseId row) const { return dims_[row]; }
+    double popularity(DenseId row) const { return popularity_[row]; }
+    float norm(DenseId row) const { return norms_[row]; }
+    DenseId artist(DenseId row) const { return artists_[row]; } // kInvalidDenseId if unknown
+
+    // memory per song: this store vs. the scan fields of a Song record
+    // (features vector + heap block, popularity, artist_id)
+    double bytesPerSong() const;
+    static double recordBytesPerSong(const SongDatabase& songs);
+
+private:
+    FeaturePrecision next_precision_ = kDefaultFeaturePrecision;
+    FeaturePrecision precision_ = kDefaultFeaturePrecision;
+    size_t stride_ = 0;
+    size_t live_count_ = 0;
+    FloatVector features_;       // rows() * stride_ (Float32)
+    BFloat16Vector bf16_features_; // rows() * stride_ (BFloat16)
+    vector<double> popularity_;  // kept exact: it is compared against thresholds
+    vector<float> norms_;        // L2 norm of each feature row
+    vector<DenseId> artists_;
+    vector<uint8_t> dims_;       // feature count before padding
+    vector<uint8_t> live_;
+
+    void resizeRows(size_t rows);
+    void setRow(DenseId row, const Song& song, const ArtistDatabase& artists);
+    void clearRow(DenseId row);
+};
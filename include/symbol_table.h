@@ -0,0 +1,90 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <shared_mutex>
+#include <atomic>
+#include <cstdint>
+using namespace std;
+
+// Compact handle for an interned string (genres, tags)
+using Symbol = uint32_t;
+
+// The empty string is always interned first
+constexpr Symbol kEmptySymbol = 0;
+
+// Interning statistics
+struct InternStats {
+    size_t lookups = 0;      // intern() calls
+    size_t hits = 0;         // calls that found an existing symbol
+    size_t distinct = 0;     // strings stored in the pool
+    size_t raw_bytes = 0;    // what the interned values would cost as separate std::strings
+    size_t pool_bytes = 0;   // what the pool actually stores
+
+    double hitRate() const { return lookups > 0 ? static_cast<double>(hits) / lookups : 0.0; }
+    long long bytesSaved() const {
+        return static_cast<long long>(raw_bytes) - static_cast<long long>(pool_bytes) -
+               static_cast<long long>(lookups * sizeof(Symbol));
+    }
+};
+
+// Thread-safe string interning pool. Each distinct value is stored once and
+// records keep a 4-byte Symbol instead of their own std::string.
+class SymbolTable {
+public:
+    // process-wide pool shared by the loaders, FeatureExtractor and the similarity code
+    static SymbolTable& global();
+
+    SymbolTable();
+
+    // map a string to its symbol, adding it on first use
+    Symbol intern(string_view text);
+
+    // look up an existing symbol without adding it
+    bool find(string_view text, Symbol& symbol) const;
+
+    // resolve a symbol back to its string
+    const string& str(Symbol symbol) const;
+
+    size_t size() const;
+    InternStats getStats() const;
+
+    // Per-thread front end for one parser chunk. While a batch is alive on a
+    // thread, intern() on its table answers repeats from the batch's own cache
+    // (no lock) and counts statistics locally; they are merged into the table
+    // once, when the batch ends.
+    class LocalBatch {
+    public:
+        explicit LocalBatch(SymbolTable& table);
+        ~LocalBatch();
+        LocalBatch(const LocalBatch&) = delete;
+        LocalBatch& operator=(const LocalBatch&) = delete;
+
+    private:
+        friend class SymbolTable;
+        SymbolTable& table_;
+        LocalBatch* previous_;                     // batch this one shadows on the thread
+        unordered_map<string_view, Symbol> cache_; // views into the table's strings
+        size_t lookups_ = 0;
+        size_t hits_ = 0;
+        size_t raw_bytes_ = 0;
+    };
+
+private:
+    mutable shared_mutex mutex_;
+    deque<string> strings_;                    // deque keeps element addresses stable
+    unordered_map<string_view, Symbol> index_; // views into strings_
+
+    atomic<size_t> lookups_{0};
+    atomic<size_t> hits_{0};
+    atomic<size_t> raw_bytes_{0};
+    size_t pool_bytes_ = 0;
+
+    // find or add under the lock; `existed` tells a hit, `stored` is the pooled string
+    Symbol internShared(string_view text, bool& existed, const string*& stored);
+};
+
+// Shorthands for the global pool
+inline Symbol internSymbol(string_view text) { return SymbolTable::global().intern(text); }
+inline const string& symbolName(Symbol symbol) { return SymbolTable::global().str(symbol); }
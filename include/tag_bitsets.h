@@ -0,0 +1,72 @@
+#pragma once
+#include "types.h"
+#include "index_blob.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+using namespace std;
+
+// Artist tags encoded against a catalog-wide vocabulary: bit b of an artist's
+// row is set when the artist carries the vocabulary's b-th tag. Every row has
+// the same width (words()) and rows are contiguous by artist dense id, so tag
+// set sizes, intersections and Jaccard scores are AND + popcount over a few
+// words, with no strings or hashing on the scan path.
+//
+// Past kMaxDenseVocabulary tags a dense row would be mostly zero words, so
+// rows are kept sparse instead: each artist's vocabulary numbers, sorted, in
+// one shared pool, and intersections merge two short arrays.
+class TagBitsets {
+public:
+    static constexpr size_t kMaxDenseVocabulary = 256;
+
+    void build(const ArtistDatabase& artists);
+    // re-encode changed (upserted or erased) artists; returns false, leaving the
+    // rows untouched, when a dense row would need a tag outside the vocabulary
+    // (sparse rows take new tags as they come)
+    bool update(const ArtistDatabase& artists, const vector<DenseId>& changed_ids);
+    void clear();
+
+    // vocabulary and rows as built, for a catalog snapshot
+    void save(BlobWriter& out) const;
+    bool load(BlobReader& in);
+
+    bool sparse() const { return sparse_; }
+    size_t vocabularySize() const { return vocabulary_size_; }
+    size_t words() const { return words_; }
+    size_t rows() const { return counts_.size(); }
+
+    // dense layout only
+    const uint64_t* row(DenseId id) const { return bits_.data() + static_cast<size_t>(id) * words_; }
+    // sparse layout only: count(id) sorted vocabulary numbers
+    const uint32_t* tags(DenseId id) const { return pool_.data() + pool_begin_[id]; }
+    // distinct tags of an artist (popcount of its row)
+    size_t count(DenseId id) const { return id < counts_.size() ? counts_[id] : 0; }
+    size_t intersection(DenseId a, DenseId b) const;
+
+    // |A and B| / |A or B|, 0 when neither artist has tags
+    double jaccard(DenseId a, DenseId b) const;
+    // |A and B| / min(|A|, |B|), 0 when either artist has no tags
+    double overlap(DenseId a, DenseId b) const;
+
+private:
+    static constexpr uint32_t kNoBit = ~uint32_t(0);
+
+    vector<uint32_t> bit_of_;  // tag Symbol -> vocabulary bit (kNoBit when unused)
+    size_t vocabulary_size_ = 0;
+    bool sparse_ = false;
+
+    // dense rows
+    size_t words_ = 0;
+    vector<uint64_t> bits_;    // rows() * words_
+    vector<uint32_t> counts_;  // popcount of each row
+
+    // sparse rows: pool_[pool_begin_[id], + counts_[id]); updates append, and
+    // the pool is compacted once more than half of it is stale
+    vector<uint32_t> pool_;
+    vector<size_t> pool_begin_;
+    size_t stale_ = 0;
+
+    bool encode(const Artist& artist, uint64_t* row) const;
+    void encodeSparse(const Artist& artist, vector<uint32_t>& out);
+    void compactPool();
+};
@@ -0,0 +1,98 @@
+#pragma once
+#include "types.h"
+#include "index_blob.h"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+using namespace std;
+
+// One artist in a tag's posting list, or one tag in an artist's vector
+struct TagPosting {
+    uint32_t id;   // artist dense id (posting lists) or tag Symbol (artist vectors)
+    float weight;  // TF-IDF weight in the artist's unit-length vector
+};
+
+struct TagMatch {
+    DenseId artist;
+    double score; // cosine of the two TF-IDF vectors
+};
+
+// Sparse TF-IDF tag vectors of the artists plus the inverted index over them.
+//
+// An artist's weight for a tag is (1 + log tf) * log(1 + N / df), with tf the
+// tag's repeats on the artist, N the artist count and df the artists carrying
+// the tag; each artist vector is scaled to unit length, so the dot product of
+// two vectors is their cosine and rare shared tags dominate it.
+//
+// topK() scores document-at-a-time with MaxScore pruning: query tags are
+// ordered by their best possible contribution, and the low-bound tags that
+// together cannot lift an artist into the current top k are only probed for
+// artists found through the other lists. Only the seed's posting lists are
+// read, never the whole catalog.
+//
+// Deltas re-weigh only the changed artists: their base postings go stale and
+// their new vectors are posted to small per-tag side lists that topK() reads
+// alongside the base lists. Document frequencies are kept current and the
+// touched tags' idf refreshed; untouched artists keep the weights of the last
+// build() until the owner folds the patches back (patchesFull()).
+class TagIndex {
+public:
+    void build(const ArtistDatabase& artists);
+    void clear();
+
+    // vectors, postings and weights as built, for a catalog snapshot; save()
+    // declines (false) while delta patches are pending
+    bool save(BlobWriter& out) const;
+    bool load(BlobReader& in);
+
+    // re-weigh the changed (upserted or erased) artists
+    void update(const ArtistDatabase& artists, const vector<DenseId>& changed);
+    bool patchesFull() const { return patched_vectors_.size() > max(kMinPatched, artist_bound_ / 8); }
+
+    size_t artistBound() const { return artist_bound_; }
+    size_t postingCount() const { return postings_.size(); }
+
+    // the artist's tags with their weights, ascending by Symbol
+    const TagPosting* vectorBegin(DenseId artist) const;
+    const TagPosting* vectorEnd(DenseId artist) const;
+    double idf(Symbol tag) const { return tag < idf_.size() ? idf_[tag] : 0.0; }
+
+    // the k artists whose tag vectors are closest to `seed`'s (the seed itself
+    // and artists rejected by `accept` are skipped); `postings_read`, when
+    // given, receives the number of postings the query touched
+    vector<TagMatch> topK(DenseId seed, size_t k, const function<bool(DenseId)>& accept = nullptr,
+                          size_t* postings_read = nullptr) const;
+
+private:
+    struct PatchedList {
+        vector<TagPosting> postings; // patched artists carrying the tag, by artist id
+        float max_weight = 0.0f;
+    };
+    static constexpr size_t kMinPatched = 256; // patched artists always allowed
+
+    size_t artist_bound_ = 0;
+    vector<size_t> vector_offsets_;  // artist -> range in vectors_
+    vector<TagPosting> vectors_;
+    vector<size_t> posting_offsets_; // tag Symbol -> range in postings_
+    vector<TagPosting> postings_;
+    vector<float> max_weight_;       // tag Symbol -> largest weight in its posting list
+    vector<double> idf_;             // tag Symbol -> idf
+    vector<uint32_t> df_;            // tag Symbol -> live artists carrying it
+    vector<uint8_t> live_;           // artist -> counted in df_
+    size_t live_artists_ = 0;
+
+    // delta patches: changed artists' vectors (empty once erased) and postings;
+    // their entries in vectors_/postings_ are stale
+    unordered_map<DenseId, vector<TagPosting>> patched_vectors_;
+    unordered_map<Symbol, PatchedList> patched_postings_;
+    vector<uint8_t> stale_;
+
+    bool stale(DenseId artist) const { return artist < stale_.size() && stale_[artist]; }
+    // the artist's unit-length vector under the current idf_, appended to `out`
+    void weigh(const Artist& artist, vector<TagPosting>& out) const;
+    // tag Symbols of the artist, each once
+    static vector<Symbol> distinctTags(const Artist& artist);
+};
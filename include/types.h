@@ -1,23 +1,28 @@
 #pragma once
 #include <string>
 #include <vector>
-#include <map>
+#include <cstdint>
+#include "symbol_table.h"
+#include "packed_id.h"
+#include "genre_table.h"
+#include "catalog.h"
 using namespace std;
 
 struct Artist {
     string name;
-    string genre;
+    Symbol genre = kEmptySymbol; // interned, see symbolName()
+    GenreCode genre_code = GenreCode::Unknown; // encodeGenre(genre), set at ingest
     double popularity_score; //0.0 - 1.0
-    vector<string> tags;
-    string id;
+    vector<Symbol> tags; // interned, see symbolName()
+    PackedId id;
 };
 
 struct Song {
     string name;
-    string artist_id;
+    PackedId artist_id;
     vector<double> features; // musical features
     double popularity_score; //0.0 - 1.0
-    string id;
+    PackedId id;
 };
 
 struct RecommendationResult {
@@ -26,8 +31,17 @@ struct RecommendationResult {
     double similarity_score; // 0.0 - 1.0
     double adjusted_score; // 0.0 - 1.0
     string reason; // why this song / artist was recommended
+    DenseId item_id = kInvalidDenseId; // recommended artist / song in its catalog
 };
 
-using ArtistDatabase = map<string, Artist>;
-using SongDatabase = map<string, Song>;
+// Cluster of every live artist / song in dense id order, persisted with a
+// catalog snapshot so that a restart can skip k-means (clusters == 0: none)
+struct ClusterAssignments {
+    uint32_t clusters = 0;
+    vector<int32_t> artists;
+    vector<int32_t> songs;
+};
+
+using ArtistDatabase = DenseCatalog<Artist>;
+using SongDatabase = DenseCatalog<Song>;
 using RecommendationList = vector<RecommendationResult>;
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 #include "types.h"
 #include "recommendation_engine.h"
+#include "data_loader.h"
+#include "catalog_merger.h"
+#include "catalog_version.h"
 #include <string> 
 using namespace std;
 
@@ -20,15 +23,24 @@ public:
     bool processUserCommand(const string& command);
 
 private:
-    RecommendationEngine engine_;
-    ArtistDatabase artists_;
-    SongDatabase songs_;
+    DataLoader loader_;
+    CatalogMerger merger_;
+    ColumnarCatalog song_columns_; // on-disk song catalog, used while it matches the current songs
+    uint64_t columns_version_ = 0; // catalog version song_columns_ was opened for
+    CatalogHandle catalog_;        // published catalog versions with their engines (changed only through writers)
 
     // helper methods and functions
     void loadData();
     void loadSpotifyData();
-    void trainMLModels();
+    void applyDeltas();
+    void indexVersion(CatalogVersion& next, const ClusterAssignments* saved = nullptr,
+                      const string* indexes = nullptr);
+    bool updateRunning() const;
+    CatalogSnapshot currentCatalog();
     string getSpotifyAccessToken();
-    void handleArtistRecommendation(const string& artist_name);
-    void handleSongRecommendation(const string& song_title);
+    void handleArtistRecommendation(const string& artist_name, const CatalogVersion& catalog);
+    void handleSongRecommendation(const string& song_title, const CatalogVersion& catalog);
+    void handleSearch(const string& query, const CatalogVersion& catalog);
+    void handlePrecision(const string& choice);
+    string autocomplete(const string& input, const vector<SearchHit>& suggestions);
 };
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "artist_song_index.h"
+#include <algorithm>
+using namespace std;
+
+void ArtistSongIndex::build(const ArtistDatabase& artists, const SongDatabase& songs) {
+    artist_bound_ = artists.idBound();
+
+    patched_.clear();
+    patched_songs_ = 0;
+
+    // Bucket of every song: its artist's dense id, or the trailing unattributed bucket
+    vector<DenseId> bucket_of(songs.idBound(), kInvalidDenseId);
+    song_artist_.assign(songs.idBound(), kNotIndexed);
+    offsets_.assign(artist_bound_ + 2, 0);
+    for (auto it = songs.begin(); it != songs.end(); ++it) {
+        DenseId artist = artists.find(it->artist_id);
+        DenseId bucket = artist != kInvalidDenseId ? artist : static_cast<DenseId>(artist_bound_);
+        bucket_of[it.id()] = bucket;
+        song_artist_[it.id()] = artist; // kInvalidDenseId doubles as kUnattributed
+        ++offsets_[bucket + 1];
+    }
+    song_count_ = songs.size();
+    for (size_t bucket = 1; bucket < offsets_.size(); ++bucket) offsets_[bucket] += offsets_[bucket - 1];
+
+    // Fill in id order, so every bucket comes out sorted
+    song_ids_.resize(songs.size());
+    vector<size_t> cursor(offsets_.begin(), offsets_.end() - 1);
+    for (DenseId id = 0; id < bucket_of.size(); ++id) {
+        if (bucket_of[id] != kInvalidDenseId) song_ids_[cursor[bucket_of[id]]++] = id;
+    }
+}
+
+void ArtistSongIndex::update(const ArtistDatabase& artists, const SongDatabase& songs,
+                             const vector<DenseId>& upserted_artists, const vector<DenseId>& deleted_artists,
+                             const vector<DenseId>& upserted_songs, const vector<DenseId>& deleted_songs) {
+    if (song_artist_.size() < songs.idBound()) song_artist_.resize(songs.idBound(), kNotIndexed);
+
+    // Re-resolve one song's artist and move it if its bucket changed
+    auto rehome = [&](DenseId song) {
+        DenseId before = song_artist_[song];
+        DenseId after = songs.contains(song) ? artists.find(songs[song].artist_id) : kNotIndexed;
+        if (before == after) return;
+        if (before != kNotIndexed) {
+            vector<DenseId>& ids = patchedBucket(before);
+            auto pos = lower_bound(ids.begin(), ids.end(), song);
+            if (pos != ids.end() && *pos == song) ids.erase(pos);
+            --song_count_;
+            --patched_songs_;
+        }
+        if (after != kNotIndexed) {
+            vector<DenseId>& ids = patchedBucket(after);
+            ids.insert(lower_bound(ids.begin(), ids.end(), song), song);
+            ++song_count_;
+            ++patched_songs_;
+        }
+        song_artist_[song] = after;
+    };
+
+    for (DenseId song : upserted_songs) rehome(song);
+    for (DenseId song : deleted_songs) rehome(song);
+
+    // A deleted artist's songs become unattributed; a new artist may claim
+    // unattributed songs. Only those two buckets are read.
+    for (DenseId artist : deleted_artists) {
+        IdRange range = bucket(artist);
+        vector<DenseId> orphans(range.begin(), range.end());
+        for (DenseId song : orphans) rehome(song);
+    }
+    if (!upserted_artists.empty()) {
+        IdRange range = bucket(kUnattributed);
+        vector<DenseId> claimed(range.begin(), range.end());
+        for (DenseId song : claimed) rehome(song);
+    }
+}
+
+vector<DenseId>& ArtistSongIndex::patchedBucket(DenseId key) {
+    auto [it, inserted] = patched_.try_emplace(key);
+    if (inserted) {
+        IdRange base = key == kUnattributed ? slice(artist_bound_) : key < artist_bound_ ? slice(key) : IdRange{};
+        it->second.assign(base.begin(), base.end());
+        patched_songs_ += it->second.size();
+    }
+    return it->second;
+}
+
+void ArtistSongIndex::clear() {
+    artist_bound_ = 0;
+    offsets_.clear();
+    song_ids_.clear();
+    song_artist_.clear();
+    song_count_ = 0;
+    patched_.clear();
+    patched_songs_ = 0;
+}
+
+bool ArtistSongIndex::save(BlobWriter& out) const {
+    if (!patched_.empty()) return false;
+    out.value<uint64_t>(artist_bound_);
+    out.value<uint64_t>(song_count_);
+    out.array(offsets_);
+    out.array(song_ids_);
+    out.array(song_artist_);
+    return true;
+}
+
+bool ArtistSongIndex::load(BlobReader& in) {
+    clear();
+    uint64_t artist_bound = 0, song_count = 0;
+    in.value(artist_bound);
+    in.value(song_count);
+    in.array(offsets_);
+    in.array(song_ids_);
+    in.array(song_artist_);
+
+    bool ok = in.ok() && !offsets_.empty() && offsets_.size() == artist_bound + 2 && offsets_.back() == song_ids_.size();
+    for (size_t i = 1; ok && i < offsets_.size(); ++i) ok = offsets_[i - 1] <= offsets_[i];
+    for (size_t i = 0; ok && i < song_ids_.size(); ++i) ok = song_ids_[i] < song_artist_.size();
+    if (!ok) {
+        clear();
+        return in.fail();
+    }
+    artist_bound_ = artist_bound;
+    song_count_ = song_count;
+    return true;
+}
+
+IdRange ArtistSongIndex::songsOf(DenseId artist) const {
+    return artist < kNotIndexed ? bucket(artist) : IdRange{};
+}
+
+IdRange ArtistSongIndex::bucket(DenseId key) const {
+    auto it = patched_.find(key);
+    if (it != patched_.end()) return {it->second.data(), it->second.data() + it->second.size()};
+    if (key == kUnattributed) return slice(artist_bound_);
+    return key < artist_bound_ ? slice(key) : IdRange{};
+}
+
+IdRange ArtistSongIndex::slice(size_t bucket) const {
+    if (bucket + 1 >= offsets_.size()) return IdRange{};
+    return {song_ids_.data() + offsets_[bucket], song_ids_.data() + offsets_[bucket + 1]};
+}
+
+vector<DenseId> ArtistSongIndex::artistOrder(const ArtistDatabase& artists, const SongDatabase& songs) {
+    ArtistSongIndex index;
+    index.build(artists, songs);
+    return std::move(index.song_ids_);
+}
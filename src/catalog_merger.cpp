@@ -0,0 +1,103 @@
+#include "catalog_merger.h"
+#include <algorithm>
+#include <utility>
+using namespace std;
+
+namespace {
+
+// Sort a batch by id and keep only the last occurrence of every id
+template <typename Record>
+void sortAndDeduplicate(vector<Record>& batch, MergeStats& stats) {
+    stable_sort(batch.begin(), batch.end(),
+        [](const Record& a, const Record& b) { return a.id < b.id; });
+
+    size_t out = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (i + 1 < batch.size() && batch[i + 1].id == batch[i].id) {
+            ++stats.batch_duplicates;
+            continue;
+        }
+        if (out != i) batch[out] = std::move(batch[i]);
+        ++out;
+    }
+    batch.resize(out);
+}
+
+// Song batches may carry empty features when the audio feature request failed;
+// keep what the catalog already knows in that case
+void combine(Artist& existing, Artist&& incoming) {
+    existing = std::move(incoming);
+}
+
+void combine(Song& existing, Song&& incoming) {
+    if (incoming.features.empty()) incoming.features = std::move(existing.features);
+    existing = std::move(incoming);
+}
+
+template <typename Database, typename Record, typename Versions, typename Version>
+MergeStats mergeBatch(Database& catalog, vector<Record>&& incoming, Versions& versions, Version version) {
+    MergeStats stats;
+    stats.incoming = incoming.size();
+    sortAndDeduplicate(incoming, stats);
+
+    for (auto& record : incoming) {
+        if (record.id.empty()) continue;
+
+        DenseId id = catalog.find(record.id);
+        if (id != kInvalidDenseId) {
+            Version current = id < versions.size() ? versions[id] : Version();
+            if (!version.supersedes(current)) {
+                ++stats.stale_dropped;
+                continue;
+            }
+            combine(catalog[id], std::move(record));
+            ++stats.replaced;
+        } else {
+            id = catalog.insert_or_assign(std::move(record)).first;
+            ++stats.inserted;
+        }
+        if (id >= versions.size()) versions.resize(catalog.idBound());
+        versions[id] = version;
+    }
+
+    incoming.clear();
+    return stats;
+}
+
+// Move provenance entries to the ids a compaction assigned
+template <typename Version>
+void remapVersions(vector<Version>& versions, const vector<DenseId>& remap, DenseId bound) {
+    vector<Version> moved(min<size_t>(versions.size(), bound));
+    for (size_t id = 0; id < versions.size() && id < remap.size(); ++id) {
+        if (remap[id] < moved.size()) moved[remap[id]] = versions[id];
+    }
+    versions = std::move(moved);
+}
+
+} // namespace
+
+MergeStats CatalogMerger::mergeArtists(ArtistDatabase& catalog, vector<Artist>&& incoming, RecordSource source) {
+    return mergeBatch(catalog, std::move(incoming), artist_versions_, Version{source, ++generation_});
+}
+
+MergeStats CatalogMerger::mergeSongs(SongDatabase& catalog, vector<Song>&& incoming, RecordSource source) {
+    return mergeBatch(catalog, std::move(incoming), song_versions_, Version{source, ++generation_});
+}
+
+vector<DenseId> CatalogMerger::compactArtists(ArtistDatabase& catalog) {
+    vector<DenseId> remap = catalog.compact();
+    remapVersions(artist_versions_, remap, catalog.idBound());
+    return remap;
+}
+
+vector<DenseId> CatalogMerger::compactSongs(SongDatabase& catalog) {
+    vector<DenseId> remap = catalog.compact();
+    remapVersions(song_versions_, remap, catalog.idBound());
+    return remap;
+}
+
+vector<DenseId> CatalogMerger::reorderSongs(SongDatabase& catalog, const vector<DenseId>& order) {
+    vector<DenseId> remap = catalog.reorder(order);
+    remapVersions(song_versions_, remap, catalog.idBound());
+    return remap;
+}
@@ -0,0 +1,37 @@
+#include "catalog_version.h"
+using namespace std;
+
+CatalogHandle::CatalogHandle() : current_(make_shared<const CatalogVersion>()) {
+}
+
+CatalogHandle::~CatalogHandle() {
+    wait();
+}
+
+CatalogSnapshot CatalogHandle::update(const Writer& write) {
+    lock_guard<mutex> lock(writer_mutex_);
+
+    CatalogSnapshot base = acquire();
+    auto next = make_shared<CatalogVersion>(*base);
+    next->number = base->number + 1;
+    if (!write(*next)) return nullptr;
+
+    CatalogSnapshot published = std::move(next);
+    atomic_store(&current_, published);
+    return published;
+}
+
+bool CatalogHandle::updateAsync(Writer write) {
+    if (pending_.exchange(true)) return false;
+    if (worker_.joinable()) worker_.join(); // the previous update has finished
+
+    worker_ = thread([this, write = std::move(write)] {
+        update(write);
+        pending_ = false;
+    });
+    return true;
+}
+
+void CatalogHandle::wait() {
+    if (worker_.joinable()) worker_.join();
+}
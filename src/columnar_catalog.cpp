@@ -0,0 +1,393 @@
+#include "columnar_catalog.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+using namespace columnar;
+
+namespace {
+
+constexpr uint64_t kSegmentAlignment = 4096;
+
+uint64_t alignSegment(uint64_t offset) {
+    return (offset + kSegmentAlignment - 1) & ~(kSegmentAlignment - 1);
+}
+
+// Serialized segment contents plus their directory entry
+struct PendingSegment {
+    SegmentInfo info;
+    string bytes;
+};
+
+template <typename T>
+void appendValue(string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// String column: (rows + 1) uint64 offsets followed by the characters
+PendingSegment buildStringColumn(ColumnId column, const vector<const string*>& values) {
+    PendingSegment segment = {};
+    segment.info.column = static_cast<uint32_t>(column);
+    segment.info.codec = static_cast<uint32_t>(Codec::Raw);
+
+    uint64_t offset = 0;
+    for (const string* value : values) {
+        appendValue<uint64_t>(segment.bytes, offset);
+        offset += value->size();
+    }
+    appendValue<uint64_t>(segment.bytes, offset);
+    for (const string* value : values) segment.bytes += *value;
+    return segment;
+}
+
+// Numeric column of `dims` interleaved dimensions, stored as doubles, or
+// quantized to uint16 with a range table of one (min, max) pair per dimension
+// in front of the values, so each dimension keeps its full 16-bit resolution
+PendingSegment buildNumericColumn(ColumnId column, const vector<double>& values, bool compress, size_t dims = 1) {
+    PendingSegment segment = {};
+    segment.info.column = static_cast<uint32_t>(column);
+
+    if (!compress) {
+        segment.info.codec = static_cast<uint32_t>(Codec::Raw);
+        for (double value : values) appendValue<double>(segment.bytes, value);
+        return segment;
+    }
+
+    segment.info.codec = static_cast<uint32_t>(Codec::Quant16);
+    vector<double> lo(dims, numeric_limits<double>::max());
+    vector<double> hi(dims, numeric_limits<double>::lowest());
+    for (size_t i = 0; i < values.size(); ++i) {
+        lo[i % dims] = min(lo[i % dims], values[i]);
+        hi[i % dims] = max(hi[i % dims], values[i]);
+    }
+    vector<double> scale(dims, 0.0);
+    for (size_t d = 0; d < dims; ++d) {
+        if (lo[d] > hi[d]) lo[d] = hi[d] = 0.0; // no rows
+        scale[d] = (hi[d] > lo[d]) ? 65535.0 / (hi[d] - lo[d]) : 0.0;
+        appendValue<double>(segment.bytes, lo[d]);
+        appendValue<double>(segment.bytes, hi[d]);
+    }
+    segment.info.min_value = dims > 0 ? *min_element(lo.begin(), lo.end()) : 0.0;
+    segment.info.max_value = dims > 0 ? *max_element(hi.begin(), hi.end()) : 0.0;
+
+    for (size_t i = 0; i < values.size(); ++i) {
+        double q = (values[i] - lo[i % dims]) * scale[i % dims] + 0.5;
+        appendValue<uint16_t>(segment.bytes, static_cast<uint16_t>(clamp(q, 0.0, 65535.0)));
+    }
+    return segment;
+}
+
+} // namespace
+
+ColumnarCatalog::~ColumnarCatalog() {
+    close();
+}
+
+bool ColumnarCatalog::write(const string& filename, const SongDatabase& songs, bool compress) {
+    const size_t rows = songs.size();
+    size_t stride = 0;
+    for (const auto& song : songs) stride = max(stride, song.features.size());
+    if (stride > numeric_limits<uint8_t>::max()) {
+        cerr << "Too many features per song for the columnar format" << endl;
+        return false;
+    }
+
+    // ids are kept as text in this format; unpack them once up front
+    vector<string> id_text, artist_id_text;
+    vector<const string*> ids, names, artist_ids;
+    vector<double> popularity, features;
+    id_text.reserve(rows);
+    artist_id_text.reserve(rows);
+    string feature_dims;
+    ids.reserve(rows);
+    names.reserve(rows);
+    artist_ids.reserve(rows);
+    popularity.reserve(rows);
+    features.reserve(rows * stride);
+    feature_dims.reserve(rows);
+
+    for (const auto& song : songs) {
+        id_text.push_back(song.id.str());
+        artist_id_text.push_back(song.artist_id.str());
+    }
+    for (const auto& song : songs) {
+        ids.push_back(&id_text[ids.size()]);
+        names.push_back(&song.name);
+        artist_ids.push_back(&artist_id_text[artist_ids.size()]);
+        popularity.push_back(song.popularity_score);
+        feature_dims.push_back(static_cast<char>(song.features.size()));
+        features.insert(features.end(), song.features.begin(), song.features.end());
+        features.insert(features.end(), stride - song.features.size(), 0.0);
+    }
+
+    vector<PendingSegment> segments;
+    segments.push_back(buildStringColumn(ColumnId::Ids, ids));
+    segments.push_back(buildStringColumn(ColumnId::Names, names));
+    segments.push_back(buildStringColumn(ColumnId::ArtistIds, artist_ids));
+    segments.push_back(buildNumericColumn(ColumnId::Popularity, popularity, compress));
+    segments.push_back({{static_cast<uint32_t>(ColumnId::FeatureDims), static_cast<uint32_t>(Codec::Raw), 0, 0, 0.0, 0.0},
+                        feature_dims});
+    segments.push_back(buildNumericColumn(ColumnId::Features, features, compress, max<size_t>(stride, 1)));
+
+    Header header = {};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.segment_count = static_cast<uint32_t>(segments.size());
+    header.song_count = rows;
+    header.feature_stride = stride;
+
+    uint64_t offset = alignSegment(sizeof(Header) + segments.size() * sizeof(SegmentInfo));
+    for (auto& segment : segments) {
+        segment.info.offset = offset;
+        segment.info.bytes = segment.bytes.size();
+        offset = alignSegment(offset + segment.bytes.size());
+    }
+
+    // Write to a temporary file and rename so readers never see a partial catalog
+    string tmp_filename = filename + ".tmp";
+    {
+        ofstream out(tmp_filename, ios::binary | ios::trunc);
+        if (!out.is_open()) return false;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& segment : segments) {
+            out.write(reinterpret_cast<const char*>(&segment.info), sizeof(SegmentInfo));
+        }
+        for (const auto& segment : segments) {
+            out.seekp(static_cast<streamoff>(segment.info.offset));
+            out.write(segment.bytes.data(), static_cast<streamsize>(segment.bytes.size()));
+        }
+        if (!out.good()) {
+            remove(tmp_filename.c_str());
+            return false;
+        }
+    }
+    return rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+bool ColumnarCatalog::open(const string& filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    Header header = {};
+    bool ok = fstat(fd, &st) == 0 &&
+              pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+              memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+              header.version == kVersion &&
+              header.segment_count <= static_cast<uint32_t>(ColumnId::Count);
+
+    vector<SegmentInfo> directory(ok ? header.segment_count : 0);
+    if (ok) {
+        ssize_t bytes = static_cast<ssize_t>(directory.size() * sizeof(SegmentInfo));
+        ok = pread(fd, directory.data(), bytes, sizeof(Header)) == bytes;
+    }
+
+    for (const auto& info : directory) {
+        if (!ok) break;
+        ok = info.column < static_cast<uint32_t>(ColumnId::Count) &&
+             !columns_[info.column].present &&
+             info.offset % kSegmentAlignment == 0 &&
+             info.offset <= static_cast<uint64_t>(st.st_size) &&
+             info.bytes <= static_cast<uint64_t>(st.st_size) - info.offset &&
+             validateSegment(fd, header, info);
+        if (ok) {
+            Column& column = columns_[info.column];
+            column.info = info;
+            column.present = true;
+        }
+    }
+
+    // Feature widths are optional (rows then use the full stride); the rest is not
+    for (ColumnId required : {ColumnId::Ids, ColumnId::Names, ColumnId::ArtistIds,
+                              ColumnId::Popularity, ColumnId::Features}) {
+        ok = ok && columns_[static_cast<size_t>(required)].present;
+    }
+
+    if (!ok) {
+        cerr << "Invalid or incompatible columnar catalog: " << filename << endl;
+        ::close(fd);
+        for (auto& column : columns_) column.present = false;
+        return false;
+    }
+
+    fd_ = fd;
+    header_ = header;
+    return true;
+}
+
+bool ColumnarCatalog::validateSegment(int fd, const Header& header, const SegmentInfo& info) {
+    const uint64_t rows = header.song_count;
+    const uint64_t stride = header.feature_stride;
+    if (stride > numeric_limits<uint8_t>::max()) return false;
+    if (info.codec != static_cast<uint32_t>(Codec::Raw) && info.codec != static_cast<uint32_t>(Codec::Quant16)) {
+        return false;
+    }
+    const bool quantized = info.codec == static_cast<uint32_t>(Codec::Quant16);
+    const uint64_t width = quantized ? sizeof(uint16_t) : sizeof(double);
+    // quantized columns start with a (min, max) pair per dimension
+    auto ranges = [&](uint64_t dims) { return quantized ? dims * 2 * sizeof(double) : 0; };
+
+    // Every segment holds exactly what the header's row count calls for
+    switch (static_cast<ColumnId>(info.column)) {
+    case ColumnId::Ids:
+    case ColumnId::Names:
+    case ColumnId::ArtistIds: {
+        // (rows + 1) offsets, then the characters; the last offset ends the segment
+        if (info.codec != static_cast<uint32_t>(Codec::Raw)) return false;
+        if (rows >= info.bytes / sizeof(uint64_t)) return false;
+        uint64_t table = (rows + 1) * sizeof(uint64_t);
+        uint64_t first = 0, last = 0;
+        if (pread(fd, &first, sizeof(first), static_cast<off_t>(info.offset)) != sizeof(first) ||
+            pread(fd, &last, sizeof(last), static_cast<off_t>(info.offset + rows * sizeof(uint64_t))) != sizeof(last)) {
+            return false;
+        }
+        return first == 0 && last == info.bytes - table;
+    }
+    case ColumnId::Popularity:
+        return info.bytes >= ranges(1) && rows <= (info.bytes - ranges(1)) / width &&
+               info.bytes == ranges(1) + rows * width;
+    case ColumnId::FeatureDims:
+        return info.codec == static_cast<uint32_t>(Codec::Raw) && info.bytes == rows;
+    case ColumnId::Features: {
+        const uint64_t dims = max<uint64_t>(stride, 1);
+        if (info.bytes < ranges(dims)) return false;
+        if (stride != 0 && rows > (info.bytes - ranges(dims)) / width / stride) return false;
+        return info.bytes == ranges(dims) + rows * stride * width;
+    }
+    default:
+        return false;
+    }
+}
+
+void ColumnarCatalog::close() {
+    lock_guard<mutex> lock(map_mutex_);
+    for (auto& column : columns_) {
+        if (column.mapping != nullptr) munmap(column.mapping, column.mapping_length);
+        column.mapping = nullptr;
+        column.mapping_length = 0;
+        column.data.store(nullptr);
+        column.present = false;
+    }
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    header_ = {};
+}
+
+const char* ColumnarCatalog::columnData(ColumnId id) const {
+    Column& column = columns_[static_cast<size_t>(id)];
+    const char* data = column.data.load(memory_order_acquire);
+    if (data != nullptr || !column.present) return data;
+
+    lock_guard<mutex> lock(map_mutex_);
+    data = column.data.load(memory_order_relaxed);
+    if (data != nullptr) return data;
+
+    // Segments are page aligned, so each column maps on its own
+    size_t length = max<size_t>(column.info.bytes, 1);
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd_, static_cast<off_t>(column.info.offset));
+    if (mapping == MAP_FAILED) {
+        cerr << "Failed to map column " << column.info.column << endl;
+        return nullptr;
+    }
+    column.mapping = mapping;
+    column.mapping_length = length;
+    data = static_cast<const char*>(mapping);
+    column.data.store(data, memory_order_release);
+    return data;
+}
+
+bool ColumnarCatalog::isMapped(ColumnId column) const {
+    return columns_[static_cast<size_t>(column)].data.load(memory_order_acquire) != nullptr;
+}
+
+size_t ColumnarCatalog::mappedBytes() const {
+    lock_guard<mutex> lock(map_mutex_);
+    size_t total = 0;
+    for (const auto& column : columns_) total += column.mapping_length;
+    return total;
+}
+
+string_view ColumnarCatalog::stringAt(ColumnId id, size_t row) const {
+    const char* data = columnData(id);
+    if (data == nullptr || row >= size()) return string_view();
+
+    // The table's ends were checked by open(); inner offsets are checked per read
+    const Column& column = columns_[static_cast<size_t>(id)];
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(data);
+    const uint64_t payload = column.info.bytes - (size() + 1) * sizeof(uint64_t);
+    const char* chars = data + (size() + 1) * sizeof(uint64_t);
+    uint64_t begin = offsets[row], end = offsets[row + 1];
+    if (begin > end || end > payload) return string_view();
+    return string_view(chars + begin, end - begin);
+}
+
+double ColumnarCatalog::decode(const Column& column, const char* data, size_t index, size_t dims) const {
+    if (column.info.codec == static_cast<uint32_t>(Codec::Quant16)) {
+        const double* range = reinterpret_cast<const double*>(data) + 2 * (index % dims);
+        uint16_t q;
+        memcpy(&q, data + dims * 2 * sizeof(double) + index * sizeof(uint16_t), sizeof(q));
+        return range[0] + q * (range[1] - range[0]) / 65535.0;
+    }
+    double value;
+    memcpy(&value, data + index * sizeof(double), sizeof(value));
+    return value;
+}
+
+string_view ColumnarCatalog::id(size_t row) const {
+    return stringAt(ColumnId::Ids, row);
+}
+
+string_view ColumnarCatalog::name(size_t row) const {
+    return stringAt(ColumnId::Names, row);
+}
+
+string_view ColumnarCatalog::artistId(size_t row) const {
+    return stringAt(ColumnId::ArtistIds, row);
+}
+
+double ColumnarCatalog::popularity(size_t row) const {
+    const char* data = columnData(ColumnId::Popularity);
+    if (data == nullptr || row >= size()) return 0.0;
+    return decode(columns_[static_cast<size_t>(ColumnId::Popularity)], data, row, 1);
+}
+
+size_t ColumnarCatalog::featureCount(size_t row) const {
+    const char* data = columnData(ColumnId::FeatureDims);
+    if (data == nullptr || row >= size()) return featureStride();
+    return static_cast<uint8_t>(data[row]);
+}
+
+void ColumnarCatalog::features(size_t row, double* out) const {
+    const size_t stride = featureStride();
+    const char* data = columnData(ColumnId::Features);
+    if (data == nullptr || row >= size()) {
+        fill(out, out + stride, 0.0);
+        return;
+    }
+    const Column& column = columns_[static_cast<size_t>(ColumnId::Features)];
+    for (size_t d = 0; d < stride; ++d) {
+        out[d] = decode(column, data, row * stride + d, stride);
+    }
+}
+
+Song ColumnarCatalog::materialize(size_t row) const {
+    Song song;
+    song.id = PackedId::parse(id(row));
+    song.name = name(row);
+    song.artist_id = PackedId::parse(artistId(row));
+    song.popularity_score = popularity(row);
+    song.features.resize(featureStride());
+    features(row, song.features.data());
+    song.features.resize(min(featureCount(row), featureStride()));
+    return song;
+}
@@ -0,0 +1,181 @@
+#include "csv_tokenizer.h"
+#include <charconv>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+using namespace std;
+
+void CsvField::assignTo(string& out) const {
+    if (!escaped) {
+        out.assign(raw.data(), raw.size());
+        return;
+    }
+    out.clear();
+    out.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i) {
+        out.push_back(raw[i]);
+        if (raw[i] == '"' && i + 1 < raw.size() && raw[i + 1] == '"') ++i;
+    }
+}
+
+string CsvField::str() const {
+    string out;
+    assignTo(out);
+    return out;
+}
+
+size_t CsvTokenizer::findByte(const char* data, size_t size, size_t pos, char c) {
+#if defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(c);
+    while (pos + 16 <= size) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask != 0) return pos + __builtin_ctz(mask);
+        pos += 16;
+    }
+#endif
+    for (; pos < size; ++pos) {
+        if (data[pos] == c) return pos;
+    }
+    return size;
+}
+
+size_t CsvTokenizer::findFieldEnd(const char* data, size_t size, size_t pos) {
+#if defined(__SSE2__)
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (pos + 16 <= size) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, comma), _mm_cmpeq_epi8(block, newline));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) return pos + __builtin_ctz(mask);
+        pos += 16;
+    }
+#endif
+    for (; pos < size; ++pos) {
+        if (data[pos] == ',' || data[pos] == '\n') return pos;
+    }
+    return size;
+}
+
+size_t CsvTokenizer::countByte(const char* data, size_t size, char c) {
+    size_t count = 0;
+    size_t pos = 0;
+#if defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(c);
+    while (pos + 16 <= size) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+        pos += 16;
+    }
+#endif
+    for (; pos < size; ++pos) {
+        if (data[pos] == c) ++count;
+    }
+    return count;
+}
+
+bool CsvTokenizer::nextRecord(vector<CsvField>& fields) {
+    fields.clear();
+    last_terminated_ = false;
+    if (pos_ >= buffer_.size()) return false;
+
+    const char* data = buffer_.data();
+    const size_t size = buffer_.size();
+
+    while (true) {
+        CsvField field;
+
+        if (data[pos_] == '"') {
+            // Quoted field: runs to the next quote that is not doubled
+            size_t begin = ++pos_;
+            while (true) {
+                size_t quote = findByte(data, size, pos_, '"');
+                if (quote >= size) {
+                    ++errors_.bad_quotes; // unterminated: take the rest of the buffer
+                    field.raw = string_view(data + begin, size - begin);
+                    pos_ = size;
+                    break;
+                }
+                if (quote + 1 < size && data[quote + 1] == '"') {
+                    field.escaped = true;
+                    pos_ = quote + 2;
+                    continue;
+                }
+                field.raw = string_view(data + begin, quote - begin);
+                pos_ = quote + 1;
+                break;
+            }
+
+            // Only a delimiter (optionally after '\r') may follow the closing quote
+            size_t end = findFieldEnd(data, size, pos_);
+            bool only_cr = (end == pos_ + 1 && data[pos_] == '\r');
+            if (end > pos_ && !only_cr) ++errors_.bad_quotes;
+            pos_ = end;
+        } else {
+            size_t end = findFieldEnd(data, size, pos_);
+            field.raw = string_view(data + pos_, end - pos_);
+            if ((end == size || data[end] == '\n') && !field.raw.empty() && field.raw.back() == '\r') {
+                field.raw.remove_suffix(1);
+            }
+            pos_ = end;
+        }
+
+        fields.push_back(field);
+
+        if (pos_ >= size) return true;
+        if (data[pos_] == ',') {
+            ++pos_;
+            if (pos_ >= size) {
+                fields.push_back(CsvField()); // trailing empty field
+                return true;
+            }
+            continue;
+        }
+
+        ++pos_; // newline
+        last_terminated_ = true;
+        return true;
+    }
+}
+
+double CsvTokenizer::parseNumber(string_view text, double fallback) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) text.remove_suffix(1);
+    if (!text.empty() && text.front() == '+') text.remove_prefix(1);
+
+    double value = fallback;
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || result.ec != errc() || result.ptr != text.data() + text.size()) {
+        ++errors_.malformed_numbers;
+        return fallback;
+    }
+    return value;
+}
+
+vector<string_view> CsvTokenizer::splitRecords(string_view buffer, unsigned parts) {
+    vector<string_view> chunks;
+    const char* data = buffer.data();
+    const size_t size = buffer.size();
+    size_t begin = 0;
+
+    for (unsigned i = 1; i <= parts && begin < size; ++i) {
+        size_t end = size;
+        if (i < parts) {
+            // A newline is a record boundary only when an even number of quotes precede it
+            size_t target = max(begin, size * i / parts);
+            size_t newline = findByte(data, size, target, '\n');
+            size_t quotes = countByte(data + begin, min(newline, size) - begin, '"');
+            while (newline < size && quotes % 2 != 0) {
+                size_t next = findByte(data, size, newline + 1, '\n');
+                quotes += countByte(data + newline + 1, min(next, size) - (newline + 1), '"');
+                newline = next;
+            }
+            end = (newline >= size) ? size : newline + 1;
+        }
+        chunks.push_back(buffer.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}
@@ -1,6 +1,342 @@
 #include "data_loader.h"
+#include "mapped_file.h"
+#include "snapshot_file.h"
+#include "csv_tokenizer.h"
 #include <fstream>
-#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <charconv>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <sys/resource.h>
+#include <cmath>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+// Insert or replace a record by id, logging ids that were already present;
+// records without an id are counted in `rejected` and not stored
+template <typename Database, typename Record>
+void storeRecord(Database& db, Record&& record, DuplicateLog& duplicates, size_t& rejected) {
+    if (record.id.empty()) {
+        ++rejected;
+        return;
+    }
+    auto [id, inserted] = db.insert_or_assign(std::forward<Record>(record));
+    if (!inserted) duplicates.note(db.key(id).str());
+}
+
+// Remove records without an id (the loaders do not store them); returns how many
+template <typename Record>
+size_t dropEmptyIds(vector<Record>& records) {
+    auto kept = remove_if(records.begin(), records.end(), [](const Record& record) { return record.id.empty(); });
+    size_t dropped = records.end() - kept;
+    records.erase(kept, records.end());
+    return dropped;
+}
+
+// Lenient number parsing for JSON string values
+double parseDouble(string_view field, double fallback) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) {
+        field.remove_prefix(1);
+    }
+    double value = fallback;
+    auto result = from_chars(field.data(), field.data() + field.size(), value);
+    return result.ec == errc() ? value : fallback;
+}
+
+bool isBlankRecord(const vector<CsvField>& fields) {
+    return fields.size() == 1 && fields[0].raw.empty();
+}
+
+// Call fn(fields) for every non-blank record after the header
+template <typename Fn>
+size_t forEachDataRecord(CsvTokenizer& tokenizer, Fn&& fn) {
+    size_t rows = 0;
+    vector<CsvField> fields;
+
+    tokenizer.nextRecord(fields); // Skip header
+    while (tokenizer.nextRecord(fields)) {
+        if (isBlankRecord(fields)) continue;
+        fn(fields);
+        ++rows;
+    }
+    return rows;
+}
+
+// Everything after the header record of a csv buffer
+string_view skipHeader(string_view buffer) {
+    CsvTokenizer tokenizer(buffer);
+    vector<CsvField> header;
+    tokenizer.nextRecord(header);
+    return buffer.substr(tokenizer.position());
+}
+
+// Pick a thread count: the requested one (or all cores), but no chunk smaller than 1 MiB
+unsigned chooseThreadCount(unsigned requested, size_t bytes) {
+    const size_t min_chunk_bytes = 1 << 20;
+    unsigned threads = requested > 0 ? requested : max(1u, thread::hardware_concurrency());
+    size_t useful = max<size_t>(1, bytes / min_chunk_bytes);
+    return static_cast<unsigned>(min<size_t>(threads, useful));
+}
+
+// Parse every chunk into its own record buffer on its own thread.
+// Buffers come back in file order so merging them is deterministic.
+template <typename Record, typename ParseFn>
+vector<vector<Record>> parseChunksInParallel(const vector<string_view>& chunks, ParseFn parse, ParseErrors& errors) {
+    vector<vector<Record>> buffers(chunks.size());
+    vector<ParseErrors> chunk_errors(chunks.size());
+    vector<thread> workers;
+
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        workers.emplace_back([&, c]() {
+            SymbolTable::LocalBatch interning(SymbolTable::global()); // genres and tags of this chunk
+            CsvTokenizer tokenizer(chunks[c]);
+            vector<CsvField> fields;
+            while (tokenizer.nextRecord(fields)) {
+                if (isBlankRecord(fields)) continue;
+
+                buffers[c].emplace_back();
+                parse(fields, tokenizer, buffers[c].back());
+            }
+            chunk_errors[c] = tokenizer.errors();
+        });
+    }
+    for (auto& worker : workers) worker.join();
+
+    for (const auto& chunk_error : chunk_errors) errors += chunk_error;
+    return buffers;
+}
+
+// Streams {"artists": [...], "songs": [...]} straight into the databases.
+// Only the record being parsed is held in memory; unknown keys are skipped.
+class CatalogSaxHandler : public nlohmann::json_sax<nlohmann::json> {
+public:
+    CatalogSaxHandler(ArtistDatabase& artists, SongDatabase& songs,
+                      DuplicateLog& artist_duplicates, DuplicateLog& song_duplicates, size_t& rejected)
+        : artists_(artists), songs_(songs),
+          artist_duplicates_(artist_duplicates), song_duplicates_(song_duplicates), rejected_(rejected) {}
+
+    size_t rows() const { return rows_; }
+    const std::string& error() const { return error_; }
+
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool binary(binary_t&) override { return true; }
+
+    bool number_integer(number_integer_t val) override {
+        return scalar(std::to_string(val), static_cast<double>(val));
+    }
+    bool number_unsigned(number_unsigned_t val) override {
+        return scalar(std::to_string(val), static_cast<double>(val));
+    }
+    bool number_float(number_float_t val, const string_t& text) override {
+        return scalar(text, val);
+    }
+    bool string(string_t& val) override {
+        return scalar(val, parseDouble(val, 0.0));
+    }
+
+    bool start_object(size_t) override {
+        ++depth_;
+        if (depth_ == kRecordDepth) {
+            artist_ = Artist();
+            song_ = Song();
+        }
+        return true;
+    }
+
+    bool end_object() override {
+        if (depth_ == kRecordDepth) commitRecord();
+        --depth_;
+        return true;
+    }
+
+    bool key(string_t& val) override {
+        if (depth_ == kRootDepth) section_key_ = val;
+        if (depth_ == kRecordDepth) field_ = val;
+        return true;
+    }
+
+    bool start_array(size_t) override {
+        ++depth_;
+        if (depth_ == kSectionDepth) {
+            section_ = section_key_ == "artists" ? Section::Artists
+                     : section_key_ == "songs" ? Section::Songs
+                     : Section::None;
+        }
+        return true;
+    }
+
+    bool end_array() override {
+        if (depth_ == kSectionDepth) section_ = Section::None;
+        --depth_;
+        return true;
+    }
+
+    bool parse_error(size_t, const std::string&, const nlohmann::detail::exception& ex) override {
+        error_ = ex.what();
+        return false;
+    }
+
+private:
+    enum class Section { None, Artists, Songs };
+
+    // root object -> section array -> record object -> list field
+    static constexpr int kRootDepth = 1;
+    static constexpr int kSectionDepth = 2;
+    static constexpr int kRecordDepth = 3;
+    static constexpr int kListDepth = 4;
+
+    ArtistDatabase& artists_;
+    SongDatabase& songs_;
+    DuplicateLog& artist_duplicates_;
+    DuplicateLog& song_duplicates_;
+    size_t& rejected_;
+    Section section_ = Section::None;
+    int depth_ = 0;
+    std::string section_key_;
+    std::string field_;
+    std::string error_;
+    size_t rows_ = 0;
+
+    Artist artist_;
+    Song song_;
+
+    bool scalar(const std::string& text, double number) {
+        if (section_ == Section::Artists) {
+            if (depth_ == kRecordDepth) {
+                if (field_ == "id") artist_.id = PackedId::parse(text);
+                else if (field_ == "name") artist_.name = text;
+                else if (field_ == "genre") {
+                    artist_.genre = internSymbol(text);
+                    artist_.genre_code = encodeGenre(text);
+                }
+                else if (field_ == "popularity_score") artist_.popularity_score = number;
+            } else if (depth_ == kListDepth && field_ == "tags") {
+                artist_.tags.push_back(internSymbol(text));
+            }
+        } else if (section_ == Section::Songs) {
+            if (depth_ == kRecordDepth) {
+                if (field_ == "id") song_.id = PackedId::parse(text);
+                else if (field_ == "name") song_.name = text;
+                else if (field_ == "artist_id") song_.artist_id = PackedId::parse(text);
+                else if (field_ == "popularity_score") song_.popularity_score = number;
+            } else if (depth_ == kListDepth && field_ == "features") {
+                song_.features.push_back(number);
+            }
+        }
+        return true;
+    }
+
+    void commitRecord() {
+        if (section_ == Section::Artists) {
+            storeRecord(artists_, std::move(artist_), artist_duplicates_, rejected_);
+            ++rows_;
+        } else if (section_ == Section::Songs) {
+            storeRecord(songs_, std::move(song_), song_duplicates_, rejected_);
+            ++rows_;
+        }
+    }
+};
+
+// Peak resident set size of this process so far
+size_t peakRssKB() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return static_cast<size_t>(usage.ru_maxrss); // kilobytes on Linux
+}
+
+// Apply the complete records of a change file: upserts are parsed with `parse`,
+// deletes only need the id. Returns the number of bytes consumed.
+template <typename Database, typename ParseFn>
+size_t applyChangeRecords(string_view buffer, bool skip_header, Database& db,
+                          DeltaResult& result, ParseErrors& errors, ParseFn parse) {
+    CsvTokenizer tokenizer(buffer);
+    vector<CsvField> fields;
+    size_t consumed = 0;
+
+    while (true) {
+        size_t record_start = tokenizer.position();
+        if (!tokenizer.nextRecord(fields)) break;
+
+        // A record without its newline may still be being written; leave it for next time
+        if (!tokenizer.lastRecordTerminated()) {
+            consumed = record_start;
+            break;
+        }
+        consumed = tokenizer.position();
+
+        if (skip_header) {
+            skip_header = false;
+            continue;
+        }
+        if (isBlankRecord(fields)) continue;
+
+        string_view op = fields[0].raw;
+        if (op == "upsert") {
+            typename Database::mapped_type record;
+            parse(fields, 1, tokenizer, record);
+            if (record.id.empty()) {
+                ++result.rejected;
+                continue;
+            }
+            result.upserted_ids.push_back(db.insert_or_assign(std::move(record)).first);
+        } else if (op == "delete") {
+            // Looked up without interning: an unknown id cannot be in the catalog
+            string text = fields.size() > 1 ? fields[1].str() : string();
+            if (text.empty()) {
+                ++result.rejected;
+                continue;
+            }
+            PackedId id;
+            if (!PackedId::find(text, id)) continue;
+            DenseId erased = db.erase(id);
+            if (erased != kInvalidDenseId) result.deleted_ids.push_back(erased);
+        } else {
+            ++result.rejected;
+        }
+    }
+
+    errors += tokenizer.errors();
+    return consumed;
+}
+
+// Per-thread state of the validation pass, merged once all threads finish
+struct PartialValidation {
+    ValidationReport counts;
+    vector<uint64_t> referenced_artists;          // bitmap over artist dense ids
+    map<size_t, size_t> feature_dims;             // feature count -> songs
+    map<size_t, vector<ValidationSample>> dim_samples;
+};
+
+void addSample(vector<ValidationSample>& samples, const string& check, const string& id, const string& detail) {
+    size_t same_check = count_if(samples.begin(), samples.end(),
+        [&](const ValidationSample& sample) { return sample.check == check; });
+    if (same_check < ValidationReport::kMaxSamplesPerCheck) {
+        samples.push_back({check, id, detail});
+    }
+}
+
+bool validPopularity(double score) {
+    return std::isfinite(score) && score >= 0.0 && score <= 1.0;
+}
+
+// Run fn(part, begin, end) over [0, count) split into `parts` contiguous ranges
+template <typename Fn>
+void runInParallel(size_t count, unsigned parts, Fn fn) {
+    vector<thread> workers;
+    for (unsigned p = 0; p < parts; ++p) {
+        size_t begin = count * p / parts;
+        size_t end = count * (p + 1) / parts;
+        workers.emplace_back(fn, p, begin, end);
+    }
+    for (auto& worker : workers) worker.join();
+}
+
+} // namespace
 
 bool DataLoader::loadArtistsFromCSV(const string& filename, ArtistDatabase& artists) {
     ifstream file(filename);
@@ -15,8 +351,7 @@ bool DataLoader::loadArtistsFromCSV(const string& filename, ArtistDatabase& arti
             first_line = false;
             continue;
         }
-        Artist artist = parseArtistFromCSV(line);
-        artists[artist.id] = artist;
+        storeRecord(artists, parseArtistFromCSV(line), artist_duplicates_, rejected_ids_);
     }
     return true;
 }
@@ -34,58 +369,488 @@ bool DataLoader::loadSongsFromCSV(const string& filename, SongDatabase& songs) {
             first_line = false;
             continue;
         }
-        Song song = parseSongFromCSV(line);
-        songs[song.id] = song;
+        storeRecord(songs, parseSongFromCSV(line), song_duplicates_, rejected_ids_);
     }
     return true;
 }
 
 Artist DataLoader::parseArtistFromCSV(const string& line) {
     Artist artist;
-    stringstream ss(line);
-    string item;
-
-    getline(ss, artist.id, ',');
-    getline(ss, artist.name, ',');
-    getline(ss, artist.genre, ',');
-    getline(ss, item, ',');
-    try {
-        artist.popularity_score = stod(item);
-    } catch (const std::invalid_argument& e) {
-        artist.popularity_score = 0.0; // Default value
-    }
+    CsvTokenizer tokenizer(line);
+    vector<CsvField> fields;
 
-    getline(ss, item, ',');
-    stringstream tagss(item);
-    while(getline(tagss, item, ';')) {
-        artist.tags.push_back(item);
-    }
+    tokenizer.nextRecord(fields);
+    parseArtistRecord(fields, 0, tokenizer, artist);
+    parse_errors_ += tokenizer.errors();
     return artist;
 }
 
 Song DataLoader::parseSongFromCSV(const string& line) {
     Song song;
-    stringstream ss(line);
-    string item;
+    CsvTokenizer tokenizer(line);
+    vector<CsvField> fields;
+
+    tokenizer.nextRecord(fields);
+    parseSongRecord(fields, 0, tokenizer, song);
+    parse_errors_ += tokenizer.errors();
+    return song;
+}
+
+bool DataLoader::loadArtistsFromCSVMapped(const string& filename, ArtistDatabase& artists) {
+    auto start = chrono::steady_clock::now();
+
+    MappedFile file;
+    if(!file.open(filename)) return false;
+
+    last_stats_ = LoadStats();
+    last_stats_.bytes = file.size();
+
+    CsvTokenizer tokenizer(file.view());
+    last_stats_.rows = forEachDataRecord(tokenizer, [&](const vector<CsvField>& fields) {
+        Artist artist;
+        parseArtistRecord(fields, 0, tokenizer, artist);
+        storeRecord(artists, std::move(artist), artist_duplicates_, last_stats_.rejected);
+    });
+
+    rejected_ids_ += last_stats_.rejected;
+    last_stats_.errors = tokenizer.errors();
+    parse_errors_ += last_stats_.errors;
+    last_stats_.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool DataLoader::loadSongsFromCSVMapped(const string& filename, SongDatabase& songs) {
+    auto start = chrono::steady_clock::now();
+
+    MappedFile file;
+    if(!file.open(filename)) return false;
+
+    last_stats_ = LoadStats();
+    last_stats_.bytes = file.size();
+
+    CsvTokenizer tokenizer(file.view());
+    last_stats_.rows = forEachDataRecord(tokenizer, [&](const vector<CsvField>& fields) {
+        Song song;
+        parseSongRecord(fields, 0, tokenizer, song);
+        storeRecord(songs, std::move(song), song_duplicates_, last_stats_.rejected);
+    });
 
-    getline(ss, song.id, ',');
-    getline(ss, song.name, ',');
-    getline(ss, song.artist_id, ',');
-    getline(ss, item, ',');
-    try {
-        song.popularity_score = stod(item);
-    } catch (const std::invalid_argument& e) {
-        song.popularity_score = 0.0; // Default value
+    rejected_ids_ += last_stats_.rejected;
+    last_stats_.errors = tokenizer.errors();
+    parse_errors_ += last_stats_.errors;
+    last_stats_.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool DataLoader::loadArtistsFromCSVParallel(const string& filename, ArtistDatabase& artists, unsigned num_threads) {
+    auto start = chrono::steady_clock::now();
+
+    MappedFile file;
+    if(!file.open(filename)) return false;
+
+    last_stats_ = LoadStats();
+    last_stats_.bytes = file.size();
+    last_stats_.threads = chooseThreadCount(num_threads, file.size());
+
+    vector<string_view> chunks = CsvTokenizer::splitRecords(skipHeader(file.view()), last_stats_.threads);
+    auto buffers = parseChunksInParallel<Artist>(chunks,
+        [this](const vector<CsvField>& fields, CsvTokenizer& tokenizer, Artist& artist) {
+            parseArtistRecord(fields, 0, tokenizer, artist);
+        }, last_stats_.errors);
+
+    // Merge in file order so later rows win, exactly like the sequential loader;
+    // the catalog is sized for every row up front and each chunk moves in as a whole
+    for (const auto& buffer : buffers) last_stats_.rows += buffer.size();
+    artists.reserve(artists.size() + last_stats_.rows);
+    for (auto& buffer : buffers) {
+        last_stats_.rejected += dropEmptyIds(buffer);
+        artists.insert_or_assign_all(std::move(buffer), [&](DenseId id) { artist_duplicates_.note(artists.key(id).str()); });
+    }
+    rejected_ids_ += last_stats_.rejected;
+
+    parse_errors_ += last_stats_.errors;
+    last_stats_.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool DataLoader::loadSongsFromCSVParallel(const string& filename, SongDatabase& songs, unsigned num_threads) {
+    auto start = chrono::steady_clock::now();
+
+    MappedFile file;
+    if(!file.open(filename)) return false;
+
+    last_stats_ = LoadStats();
+    last_stats_.bytes = file.size();
+    last_stats_.threads = chooseThreadCount(num_threads, file.size());
+
+    vector<string_view> chunks = CsvTokenizer::splitRecords(skipHeader(file.view()), last_stats_.threads);
+    auto buffers = parseChunksInParallel<Song>(chunks,
+        [this](const vector<CsvField>& fields, CsvTokenizer& tokenizer, Song& song) {
+            parseSongRecord(fields, 0, tokenizer, song);
+        }, last_stats_.errors);
+
+    // Merge in file order so later rows win, exactly like the sequential loader;
+    // the catalog is sized for every row up front and each chunk moves in as a whole
+    for (const auto& buffer : buffers) last_stats_.rows += buffer.size();
+    songs.reserve(songs.size() + last_stats_.rows);
+    for (auto& buffer : buffers) {
+        last_stats_.rejected += dropEmptyIds(buffer);
+        songs.insert_or_assign_all(std::move(buffer), [&](DenseId id) { song_duplicates_.note(songs.key(id).str()); });
+    }
+    rejected_ids_ += last_stats_.rejected;
+
+    parse_errors_ += last_stats_.errors;
+    last_stats_.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool DataLoader::applyArtistDelta(const string& filename, ArtistDatabase& artists, DeltaResult& result) {
+    MappedFile file;
+    if(!file.open(filename)) return false;
+
+    // Start over if the file was truncated or replaced by a shorter one
+    size_t& offset = delta_offsets_[filename];
+    if (offset > file.size()) offset = 0;
+
+    offset += applyChangeRecords(file.view().substr(offset), offset == 0, artists, result, parse_errors_,
+        [this](const vector<CsvField>& fields, size_t first, CsvTokenizer& tokenizer, Artist& artist) {
+            parseArtistRecord(fields, first, tokenizer, artist);
+        });
+    return true;
+}
+
+bool DataLoader::applySongDelta(const string& filename, SongDatabase& songs, DeltaResult& result) {
+    MappedFile file;
+    if(!file.open(filename)) return false;
+
+    // Start over if the file was truncated or replaced by a shorter one
+    size_t& offset = delta_offsets_[filename];
+    if (offset > file.size()) offset = 0;
+
+    offset += applyChangeRecords(file.view().substr(offset), offset == 0, songs, result, parse_errors_,
+        [this](const vector<CsvField>& fields, size_t first, CsvTokenizer& tokenizer, Song& song) {
+            parseSongRecord(fields, first, tokenizer, song);
+        });
+    return true;
+}
+
+bool DataLoader::loadFromJSON(const string& filename, ArtistDatabase& artists, SongDatabase& songs) {
+    auto start = chrono::steady_clock::now();
+
+    ifstream file(filename, ios::binary);
+    if(!file.is_open()) return false;
+
+    last_stats_ = LoadStats();
+    file.seekg(0, ios::end);
+    last_stats_.bytes = static_cast<size_t>(file.tellg());
+    file.seekg(0, ios::beg);
+
+    // SAX parsing keeps memory bounded by one record instead of the whole document
+    CatalogSaxHandler handler(artists, songs, artist_duplicates_, song_duplicates_, last_stats_.rejected);
+    bool parsed = nlohmann::json::sax_parse(file, &handler);
+    rejected_ids_ += last_stats_.rejected;
+
+    last_stats_.rows = handler.rows();
+    last_stats_.peak_rss_kb = peakRssKB();
+    last_stats_.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (!parsed) {
+        cerr << "Failed to parse JSON catalog " << filename << ": " << handler.error() << endl;
+    }
+    return parsed;
+}
+
+bool DataLoader::validateData(const ArtistDatabase& artists, const SongDatabase& songs, const SongStore* store) {
+    return validateData(artists, songs, store, 0);
+}
+
+bool DataLoader::validateData(const ArtistDatabase& artists, const SongDatabase& songs, const SongStore* store,
+                              unsigned num_threads) {
+    auto start = chrono::steady_clock::now();
+
+    // Load-time issues are reported by this validation only
+    ParseErrors parse_errors = exchange(parse_errors_, ParseErrors());
+    size_t rejected_ids = exchange(rejected_ids_, 0);
+    DuplicateLog artist_duplicates = exchange(artist_duplicates_, DuplicateLog());
+    DuplicateLog song_duplicates = exchange(song_duplicates_, DuplicateLog());
+
+    // Dense ids give threads random access, and artist ids double as bitmap positions
+    // for the songs that reference them
+    const size_t artist_ids = artists.idBound();
+    const size_t song_ids = songs.idBound();
+
+    const size_t min_rows_per_thread = 1 << 14;
+    unsigned threads = num_threads > 0 ? num_threads : max(1u, thread::hardware_concurrency());
+    threads = static_cast<unsigned>(min<size_t>(threads, max<size_t>(1, song_ids / min_rows_per_thread)));
+
+    vector<PartialValidation> partials(threads);
+    const size_t bitmap_words = (artist_ids + 63) / 64;
+
+    // Live artists as a bitmap; the store's artist column already holds every
+    // song's artist dense id, so refs are checked without hashing the ids again
+    vector<uint64_t> live_artists(bitmap_words, 0);
+    for (auto it = artists.begin(); it != artists.end(); ++it) {
+        live_artists[it.id() / 64] |= uint64_t(1) << (it.id() % 64);
+    }
+    if (store && store->rows() != song_ids) store = nullptr;
+    auto resolveArtist = [&](DenseId song_id, const Song& song) {
+        DenseId artist = store ? store->artist(song_id) : kInvalidDenseId;
+        if (artist < artist_ids && (live_artists[artist / 64] >> (artist % 64) & 1) &&
+            artists.key(artist) == song.artist_id) {
+            return artist;
+        }
+        // Not resolved by the store, or resolved before a delta moved the artist
+        return artists.find(song.artist_id);
+    };
+
+    runInParallel(song_ids, threads, [&](unsigned part, size_t begin, size_t end) {
+        PartialValidation& local = partials[part];
+        ValidationReport& counts = local.counts;
+        local.referenced_artists.assign(bitmap_words, 0);
+
+        // Artists are split across the same threads
+        DenseId artist_begin = static_cast<DenseId>(artist_ids * part / threads);
+        DenseId artist_end = static_cast<DenseId>(artist_ids * (part + 1) / threads);
+        for (DenseId id = artist_begin; id < artist_end; ++id) {
+            if (!artists.contains(id)) continue;
+            const Artist& artist = artists[id];
+            ++counts.artists_checked;
+
+            if (artist.id.empty()) {
+                ++counts.empty_ids;
+                addSample(counts.samples, "empty_id", artist.id.str(), "artist " + artist.name);
+            } else if (artists.find(artist.id) != id) {
+                ++counts.key_mismatches;
+                addSample(counts.samples, "key_mismatch", artist.id.str(), "dense id " + to_string(id));
+            }
+            if (!validPopularity(artist.popularity_score)) {
+                ++counts.popularity_out_of_range;
+                addSample(counts.samples, "popularity_out_of_range", artist.id.str(), to_string(artist.popularity_score));
+            }
+            if (artist.genre_code == GenreCode::Unknown) {
+                ++counts.unknown_genres;
+                addSample(counts.samples, "unknown_genre", artist.id.str(), symbolName(artist.genre));
+            }
+        }
+
+        for (size_t i = begin; i < end; ++i) {
+            DenseId id = static_cast<DenseId>(i);
+            if (!songs.contains(id)) continue;
+            const Song& song = songs[id];
+            ++counts.songs_checked;
+
+            if (song.id.empty()) {
+                ++counts.empty_ids;
+                addSample(counts.samples, "empty_id", song.id.str(), "song " + song.name);
+            } else if (songs.find(song.id) != id) {
+                ++counts.key_mismatches;
+                addSample(counts.samples, "key_mismatch", song.id.str(), "dense id " + to_string(id));
+            }
+
+            DenseId artist = resolveArtist(id, song);
+            if (artist != kInvalidDenseId) {
+                local.referenced_artists[artist / 64] |= uint64_t(1) << (artist % 64);
+            } else {
+                ++counts.missing_artist_refs;
+                addSample(counts.samples, "missing_artist_ref", song.id.str(), "artist_id " + song.artist_id.str());
+            }
+
+            if (!validPopularity(song.popularity_score)) {
+                ++counts.popularity_out_of_range;
+                addSample(counts.samples, "popularity_out_of_range", song.id.str(), to_string(song.popularity_score));
+            }
+
+            bool finite = all_of(song.features.begin(), song.features.end(),
+                [](double value) { return std::isfinite(value); });
+            if (!finite) {
+                ++counts.non_finite_features;
+                addSample(counts.samples, "non_finite_features", song.id.str(), "");
+            }
+
+            size_t dims = song.features.size();
+            ++local.feature_dims[dims];
+            auto& dim_samples = local.dim_samples[dims];
+            if (dim_samples.size() < ValidationReport::kMaxSamplesPerCheck) {
+                dim_samples.push_back({"feature_dim_mismatch", song.id.str(), to_string(dims) + " features"});
+            }
+        }
+    });
+
+    // Merge the partial results
+    ValidationReport report;
+    vector<uint64_t> referenced(bitmap_words, 0);
+    map<size_t, size_t> feature_dims;
+    map<size_t, vector<ValidationSample>> dim_samples;
+
+    for (const auto& local : partials) {
+        const ValidationReport& counts = local.counts;
+        report.artists_checked += counts.artists_checked;
+        report.songs_checked += counts.songs_checked;
+        report.empty_ids += counts.empty_ids;
+        report.key_mismatches += counts.key_mismatches;
+        report.missing_artist_refs += counts.missing_artist_refs;
+        report.popularity_out_of_range += counts.popularity_out_of_range;
+        report.non_finite_features += counts.non_finite_features;
+        report.unknown_genres += counts.unknown_genres;
+        for (const auto& sample : counts.samples) {
+            addSample(report.samples, sample.check, sample.id, sample.detail);
+        }
+        for (size_t w = 0; w < local.referenced_artists.size(); ++w) {
+            referenced[w] |= local.referenced_artists[w];
+        }
+        for (const auto& [dims, count] : local.feature_dims) feature_dims[dims] += count;
+        for (const auto& [dims, samples] : local.dim_samples) {
+            auto& merged = dim_samples[dims];
+            merged.insert(merged.end(), samples.begin(), samples.end());
+        }
     }
 
-    getline(ss, item, ',');
-    stringstream fss(item);
-    while(getline(fss, item, ';')) {
-        try {
-            song.features.push_back(stod(item));
-        } catch (const std::invalid_argument& e) {
-            song.features.push_back(0.0); // Default value
+    // The most common feature count is taken as the expected dimensionality
+    size_t expected_count = 0;
+    for (const auto& [dims, count] : feature_dims) {
+        if (count > expected_count) {
+            expected_count = count;
+            report.expected_feature_dims = dims;
         }
     }
-    return song;
+    report.feature_dim_mismatches = report.songs_checked - expected_count;
+    for (const auto& [dims, samples] : dim_samples) {
+        if (dims == report.expected_feature_dims) continue;
+        for (const auto& sample : samples) {
+            addSample(report.samples, sample.check, sample.id, sample.detail);
+        }
+    }
+
+    size_t referenced_count = 0;
+    for (uint64_t word : referenced) referenced_count += __builtin_popcountll(word);
+    report.artists_without_songs = report.artists_checked - referenced_count;
+
+    report.empty_ids += rejected_ids;
+    report.malformed_numbers = parse_errors.malformed_numbers;
+    report.bad_quotes = parse_errors.bad_quotes;
+    report.duplicate_artist_ids = artist_duplicates.count;
+    report.duplicate_song_ids = song_duplicates.count;
+    for (const auto& id : artist_duplicates.samples) addSample(report.samples, "duplicate_artist_id", id, "");
+    for (const auto& id : song_duplicates.samples) addSample(report.samples, "duplicate_song_id", id, "");
+
+    report.threads = threads;
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    last_report_ = std::move(report);
+    return last_report_.ok();
+}
+
+size_t ValidationReport::errorCount() const {
+    return malformed_numbers + bad_quotes + empty_ids + key_mismatches + duplicate_artist_ids + duplicate_song_ids +
+           missing_artist_refs + popularity_out_of_range + non_finite_features + feature_dim_mismatches;
+}
+
+string ValidationReport::toJSON(int indent) const {
+    nlohmann::json j;
+    j["ok"] = ok();
+    j["artists_checked"] = artists_checked;
+    j["songs_checked"] = songs_checked;
+    j["malformed_numbers"] = malformed_numbers;
+    j["bad_quotes"] = bad_quotes;
+    j["empty_ids"] = empty_ids;
+    j["key_mismatches"] = key_mismatches;
+    j["duplicate_artist_ids"] = duplicate_artist_ids;
+    j["duplicate_song_ids"] = duplicate_song_ids;
+    j["missing_artist_refs"] = missing_artist_refs;
+    j["popularity_out_of_range"] = popularity_out_of_range;
+    j["non_finite_features"] = non_finite_features;
+    j["feature_dim_mismatches"] = feature_dim_mismatches;
+    j["expected_feature_dims"] = expected_feature_dims;
+    j["artists_without_songs"] = artists_without_songs;
+    j["unknown_genres"] = unknown_genres;
+    j["threads"] = threads;
+    j["seconds"] = seconds;
+
+    j["samples"] = nlohmann::json::array();
+    for (const auto& sample : samples) {
+        j["samples"].push_back({{"check", sample.check}, {"id", sample.id}, {"detail", sample.detail}});
+    }
+    return j.dump(indent);
+}
+
+bool DataLoader::saveSnapshot(const string& filename, const ArtistDatabase& artists, const SongDatabase& songs,
+                              const ClusterAssignments* clusters, const string* indexes) {
+    return SnapshotFile::write(filename, artists, songs, clusters, indexes);
+}
+
+bool DataLoader::loadFromSnapshot(const string& filename, ArtistDatabase& artists, SongDatabase& songs,
+                                  ClusterAssignments* clusters, string* indexes) {
+    auto start = chrono::steady_clock::now();
+
+    SnapshotFile snapshot;
+    if(!snapshot.open(filename)) return false;
+
+    bool symbols_stable = snapshot.materialize(artists, songs);
+    if (clusters) *clusters = snapshot.clusters();
+    if (indexes) *indexes = symbols_stable ? string(snapshot.indexes()) : string();
+
+    last_stats_ = LoadStats();
+    last_stats_.rows = snapshot.artistCount() + snapshot.songCount();
+    last_stats_.bytes = snapshot.sizeBytes();
+    last_stats_.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+void DataLoader::parseArtistRecord(const vector<CsvField>& fields, size_t first,
+                                   CsvTokenizer& tokenizer, Artist& artist) {
+    auto field = [&](size_t column) { return first + column < fields.size() ? fields[first + column] : CsvField(); };
+
+    // Quoted values with "" escapes need one unescaped copy before interning
+    string scratch;
+    auto text = [&](const CsvField& f) -> string_view {
+        if (!f.escaped) return f.raw;
+        f.assignTo(scratch);
+        return scratch;
+    };
+
+    artist.id = PackedId::parse(text(field(0)));
+    field(1).assignTo(artist.name);
+    string_view genre = text(field(2));
+    artist.genre = internSymbol(genre);
+    artist.genre_code = encodeGenre(genre);
+    artist.popularity_score = tokenizer.parseNumber(field(3).raw, 0.0);
+
+    CsvTokenizer::forEachListItem(text(field(4)), ';', [&](string_view tag) {
+        artist.tags.push_back(internSymbol(tag));
+    });
+}
+
+void DataLoader::parseSongRecord(const vector<CsvField>& fields, size_t first,
+                                 CsvTokenizer& tokenizer, Song& song) {
+    auto field = [&](size_t column) { return first + column < fields.size() ? fields[first + column] : CsvField(); };
+
+    // Quoted ids with "" escapes need one unescaped copy before packing
+    string scratch;
+    auto text = [&](const CsvField& f) -> string_view {
+        if (!f.escaped) return f.raw;
+        f.assignTo(scratch);
+        return scratch;
+    };
+
+    song.id = PackedId::parse(text(field(0)));
+    field(1).assignTo(song.name);
+    song.artist_id = PackedId::parse(text(field(2)));
+    song.popularity_score = tokenizer.parseNumber(field(3).raw, 0.0);
+
+    CsvTokenizer::forEachListItem(field(4).raw, ';', [&](string_view value) {
+        song.features.push_back(tokenizer.parseNumber(value, 0.0));
+    });
+}
+
+void DataLoader::printLoadStats(const string& label) const {
+    cout << "Loaded " << last_stats_.rows << " " << label
+         << " (" << last_stats_.bytes << " bytes";
+    if (last_stats_.threads > 1) cout << ", " << last_stats_.threads << " threads";
+    if (last_stats_.peak_rss_kb > 0) cout << ", peak RSS " << last_stats_.peak_rss_kb / 1024 << " MB";
+    if (last_stats_.rejected > 0) cout << ", " << last_stats_.rejected << " without an id skipped";
+    if (last_stats_.errors.total() > 0) {
+        cout << ", " << last_stats_.errors.malformed_numbers << " malformed numbers, "
+             << last_stats_.errors.bad_quotes << " bad quotes";
+    }
+    cout << ") in " << last_stats_.seconds * 1000.0 << " ms, "
+         << static_cast<size_t>(last_stats_.rowsPerSecond()) << " rows/sec" << endl;
 }
\ No newline at end of file
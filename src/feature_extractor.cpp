@@ -1,43 +1,171 @@
 #include "feature_extractor.h"
 #include <cmath>
 #include <algorithm>
+#include <thread>
 using namespace std;
 
-vector<double> FeatureExtractor::extractArtistFeatures(const Artist& artist) {
-    vector<double> features;
+namespace {
+
+// Run fn(begin, end) over [0, count) in contiguous ranges of at least
+// kMinRowsPerThread rows, on up to `requested` threads (0 = all cores)
+constexpr size_t kMinRowsPerThread = 1 << 12;
+
+template <typename Fn>
+void forEachRange(size_t count, unsigned requested, Fn fn) {
+    unsigned threads = requested > 0 ? requested : max(1u, thread::hardware_concurrency());
+    threads = static_cast<unsigned>(min<size_t>(threads, max<size_t>(1, count / kMinRowsPerThread)));
+    if (threads == 1) {
+        fn(size_t(0), count);
+        return;
+    }
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back(fn, count * t / threads, count * (t + 1) / threads);
+    }
+    for (auto& worker : workers) worker.join();
+}
+
+} // namespace
+
+ArtistFeatures FeatureExtractor::extractArtistFeatureVec(const Artist& artist) {
+    return extractArtistFeatureVec(artist, countDistinctTags(artist.tags));
+}
+
+ArtistFeatures FeatureExtractor::extractArtistFeatureVec(const Artist& artist, size_t distinct_tags) {
+    ArtistFeatures features = extractRawArtistFeatures(artist, distinct_tags);
+    features.normalize();
+    return features;
+}
+
+ArtistFeatures FeatureExtractor::extractRawArtistFeatures(const Artist& artist) {
+    return extractRawArtistFeatures(artist, countDistinctTags(artist.tags));
+}
+
+ArtistFeatures FeatureExtractor::extractRawArtistFeatures(const Artist& artist, size_t distinct_tags) {
+    ArtistFeatures features;
     
     // Extract genre feature (encoded as number)
-    features.push_back(extractGenreFeatures(artist.genre));
+    features[0] = extractGenreFeatures(artist.genre_code);
     
     // Extract popularity feature (0-1 scale)
-    features.push_back(extractPopularityFeatures(artist.popularity_score));
+    features[1] = extractPopularityFeatures(artist.popularity_score);
     
     // Extract tag features (number of tags, normalized)
-    features.push_back(extractTagFeatures(artist.tags));
+    features[2] = extractTagFeatures(artist.tags);
     
     // Extract genre diversity (how many different genres)
-    features.push_back(extractGenreDiversity(artist.tags));
+    features[3] = extractGenreDiversity(distinct_tags);
     
     // Extract underground factor (inverse of popularity)
-    features.push_back(extractUndergroundFactor(artist.popularity_score));
+    features[4] = extractUndergroundFactor(artist.popularity_score);
     
-    return normalizeFeatures(features);
+    return features;
+}
+
+vector<double> FeatureExtractor::extractArtistFeatures(const Artist& artist) {
+    return extractArtistFeatureVec(artist).toVector();
 }
 
 vector<double> FeatureExtractor::extractSongFeatures(const Song& song) {
-    vector<double> features = song.features;
-    
+    vector<double> features;
+    features.reserve(song.features.size() + 2);
+    features.assign(song.features.begin(), song.features.end());
+    finishSongFeatures(features, song.popularity_score);
+    return features;
+}
+
+vector<double> FeatureExtractor::extractSongFeatures(const SongStore& store, DenseId row) {
+    vector<double> features;
+    features.reserve(store.featureCount(row) + 2);
+    for (size_t d = 0; d < store.featureCount(row); ++d) features.push_back(store.feature(row, d));
+    finishSongFeatures(features, store.popularity(row));
+    return features;
+}
+
+void FeatureExtractor::extractArtistFeatures(const ArtistDatabase& artists, const vector<DenseId>& ids,
+                                             ArtistFeatures* out, const TagBitsets* tags,
+                                             const FeatureStats* stats, unsigned threads) {
+    bool standardize = stats && !stats->empty();
+    forEachRange(ids.size(), threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            DenseId id = ids[i];
+            if (!artists.contains(id)) {
+                out[i] = ArtistFeatures{};
+                continue;
+            }
+            const Artist& artist = artists[id];
+            ArtistFeatures raw = extractRawArtistFeatures(artist, tags ? tags->count(id) : countDistinctTags(artist.tags));
+            if (standardize) {
+                stats->standardize(raw.data(), out[i].data());
+            } else {
+                raw.normalize();
+                out[i] = raw;
+            }
+        }
+    });
+}
+
+void FeatureExtractor::extractRawArtistFeatures(const ArtistDatabase& artists, const vector<DenseId>& ids,
+                                                ArtistFeatures* out, const TagBitsets* tags, unsigned threads) {
+    forEachRange(ids.size(), threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            DenseId id = ids[i];
+            if (!artists.contains(id)) {
+                out[i] = ArtistFeatures{};
+                continue;
+            }
+            const Artist& artist = artists[id];
+            out[i] = extractRawArtistFeatures(artist, tags ? tags->count(id) : countDistinctTags(artist.tags));
+        }
+    });
+}
+
+void FeatureExtractor::extractSongFeatures(const SongStore& store, const vector<DenseId>& rows,
+                                           double* out, size_t width, unsigned threads) {
+    forEachRange(rows.size(), threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            double* row = out + i * width;
+            fill(row, row + width, 0.0);
+            if (!store.isLive(rows[i]) || width < 2) continue;
+
+            // Write the features and their squared sum in one pass, then scale in place
+            size_t dims = min(store.featureCount(rows[i]), width - 2);
+            double sum = 0.0;
+            for (size_t d = 0; d < dims; ++d) {
+                row[d] = store.feature(rows[i], d);
+                sum += row[d] * row[d];
+            }
+            // Fixed last two columns, so rows with fewer features stay aligned
+            double popularity = store.popularity(rows[i]);
+            row[width - 2] = extractPopularityFeatures(popularity);
+            row[width - 1] = extractUndergroundFactor(popularity);
+            sum += row[width - 2] * row[width - 2];
+            sum += row[width - 1] * row[width - 1];
+
+            double magnitude = sqrt(sum);
+            if (magnitude < 1e-10) continue;
+            for (size_t d = 0; d < width; ++d) row[d] /= magnitude;
+        }
+    });
+}
+
+void FeatureExtractor::finishSongFeatures(vector<double>& features, double popularity_score) {
     // Add popularity feature
-    features.push_back(extractPopularityFeatures(song.popularity_score));
+    features.push_back(extractPopularityFeatures(popularity_score));
     
     // Add underground factor
-    features.push_back(extractUndergroundFactor(song.popularity_score));
+    features.push_back(extractUndergroundFactor(popularity_score));
     
-    return normalizeFeatures(features);
+    normalizeInPlace(features);
 }
 
 vector<double> FeatureExtractor::normalizeFeatures(const vector<double>& features) {
     vector<double> normalized = features;
+    normalizeInPlace(normalized);
+    return normalized;
+}
+
+void FeatureExtractor::normalizeInPlace(vector<double>& features) {
     double sum = 0.0;
 
     // Calculate magnitude
@@ -48,61 +176,45 @@ vector<double> FeatureExtractor::normalizeFeatures(const vector<double>& feature
     
     // Avoid division by zero
     if(magnitude < 1e-10) {
-        return normalized;
+        return;
     }
 
     // Normalize each feature
-    for(double& feature : normalized) {
+    for(double& feature : features) {
         feature /= magnitude;
     }
-    
-    return normalized;
 }
 
-double FeatureExtractor::extractGenreFeatures(const string& genre) {
-    // Enhanced genre encoding with more genres
-    if(genre == "hip-hop" || genre == "rap") return 1.0;
-    if(genre == "pop") return 2.0;
-    if(genre == "rock") return 3.0;
-    if(genre == "electronic" || genre == "edm") return 4.0;
-    if(genre == "r&b" || genre == "soul") return 5.0;
-    if(genre == "indie" || genre == "alternative") return 6.0;
-    if(genre == "jazz") return 7.0;
-    if(genre == "classical") return 8.0;
-    if(genre == "country") return 9.0;
-    if(genre == "folk") return 10.0;
-    if(genre == "metal") return 11.0;
-    if(genre == "punk") return 12.0;
-    if(genre == "reggae") return 13.0;
-    if(genre == "blues") return 14.0;
-    if(genre == "funk") return 15.0;
-    if(genre == "disco") return 16.0;
-    if(genre == "latin") return 17.0;
-    if(genre == "world") return 18.0;
-    if(genre == "experimental") return 19.0;
-    if(genre == "ambient") return 20.0;
-    
-    return 0.0; // Default for unknown genres
+double FeatureExtractor::extractGenreFeatures(GenreCode genre) {
+    // Genres are canonicalized and encoded once at ingest (see genre_table.h);
+    // the code doubles as the encoding, 0.0 for unknown genres
+    return static_cast<double>(genre);
 }
 
 double FeatureExtractor::extractPopularityFeatures(double popularity_score) {
     return popularity_score; // Already 0-1 scale
 }
 
-double FeatureExtractor::extractTagFeatures(const vector<string>& tags) {
+double FeatureExtractor::extractTagFeatures(const vector<Symbol>& tags) {
     // Normalize number of tags (0-10 scale)
     return min(static_cast<double>(tags.size()) / 10.0, 1.0);
 }
 
-double FeatureExtractor::extractGenreDiversity(const vector<string>& tags) {
-    // Count unique genres in tags
-    vector<string> unique_genres;
-    for(const auto& tag : tags) {
-        if(find(unique_genres.begin(), unique_genres.end(), tag) == unique_genres.end()) {
-            unique_genres.push_back(tag);
+double FeatureExtractor::extractGenreDiversity(size_t distinct_tags) {
+    // Distinct genres among the tags, saturating at 5
+    return min(static_cast<double>(distinct_tags) / 5.0, 1.0);
+}
+
+size_t FeatureExtractor::countDistinctTags(const vector<Symbol>& tags) {
+    // Without a tag vocabulary at hand: a tag counts when it does not occur
+    // earlier in the (short) list; interned, so these are integer compares
+    size_t distinct = 0;
+    for(size_t i = 0; i < tags.size(); ++i) {
+        if(find(tags.begin(), tags.begin() + i, tags[i]) == tags.begin() + i) {
+            ++distinct;
         }
     }
-    return min(static_cast<double>(unique_genres.size()) / 5.0, 1.0);
+    return distinct;
 }
 
 double FeatureExtractor::extractUndergroundFactor(double popularity_score) {
@@ -0,0 +1,118 @@
+#include "feature_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+using namespace std;
+
+namespace {
+
+constexpr size_t kMinRowsPerThread = 1 << 14;
+constexpr double kMinVariance = 1e-12;
+
+} // namespace
+
+FeatureStats::FeatureStats(size_t dims) : mean_(dims, 0.0), m2_(dims, 0.0) {}
+
+void FeatureStats::save(BlobWriter& out) const {
+    out.value<uint64_t>(count_);
+    out.array(mean_);
+    out.array(m2_);
+}
+
+bool FeatureStats::load(BlobReader& in) {
+    const size_t dims = mean_.size();
+    uint64_t count = 0;
+    in.value(count);
+    in.array(mean_);
+    in.array(m2_);
+    if (!in.ok() || mean_.size() != dims || m2_.size() != dims) {
+        *this = FeatureStats(dims);
+        return in.fail();
+    }
+    count_ = count;
+    return true;
+}
+
+FeatureStats FeatureStats::compute(const double* rows, size_t count, size_t dims,
+                                   const uint8_t* live, unsigned threads) {
+    unsigned parts = threads > 0 ? threads : max(1u, thread::hardware_concurrency());
+    parts = static_cast<unsigned>(min<size_t>(parts, max<size_t>(1, count / kMinRowsPerThread)));
+
+    // One Welford accumulator per range, merged in range order
+    vector<FeatureStats> partials(parts, FeatureStats(dims));
+    auto reduce = [&](unsigned part) {
+        size_t begin = count * part / parts;
+        size_t end = count * (part + 1) / parts;
+        for (size_t i = begin; i < end; ++i) {
+            if (!live || live[i]) partials[part].add(rows + i * dims);
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned p = 1; p < parts; ++p) workers.emplace_back(reduce, p);
+    reduce(0);
+    for (auto& worker : workers) worker.join();
+
+    FeatureStats stats(dims);
+    for (const auto& partial : partials) stats.merge(partial);
+    return stats;
+}
+
+void FeatureStats::add(const double* row) {
+    ++count_;
+    for (size_t d = 0; d < dims(); ++d) {
+        double delta = row[d] - mean_[d];
+        mean_[d] += delta / count_;
+        m2_[d] += delta * (row[d] - mean_[d]);
+    }
+}
+
+void FeatureStats::remove(const double* row) {
+    if (count_ <= 1) {
+        *this = FeatureStats(dims());
+        return;
+    }
+    --count_;
+    for (size_t d = 0; d < dims(); ++d) {
+        double delta = row[d] - mean_[d];
+        mean_[d] -= delta / count_;
+        m2_[d] = max(0.0, m2_[d] - delta * (row[d] - mean_[d]));
+    }
+}
+
+void FeatureStats::merge(const FeatureStats& other) {
+    if (other.count_ == 0) return;
+    if (count_ == 0) {
+        *this = other;
+        return;
+    }
+    // Chan et al.: combine two (count, mean, M2) triples
+    size_t total = count_ + other.count_;
+    for (size_t d = 0; d < dims(); ++d) {
+        double delta = other.mean_[d] - mean_[d];
+        mean_[d] += delta * other.count_ / total;
+        m2_[d] += other.m2_[d] + delta * delta * (static_cast<double>(count_) * other.count_ / total);
+    }
+    count_ = total;
+}
+
+double FeatureStats::variance(size_t d) const {
+    return count_ > 0 ? m2_[d] / count_ : 0.0;
+}
+
+void FeatureStats::standardize(const double* in, double* out) const {
+    double sum = 0.0;
+    for (size_t d = 0; d < dims(); ++d) {
+        double value = in[d];
+        if (count_ > 0) {
+            double var = variance(d);
+            value = var > kMinVariance ? (value - mean_[d]) / sqrt(var) : 0.0;
+        }
+        out[d] = value;
+        sum += value * value;
+    }
+
+    double magnitude = sqrt(sum);
+    if (magnitude < 1e-10) return;
+    for (size_t d = 0; d < dims(); ++d) out[d] /= magnitude;
+}
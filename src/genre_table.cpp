@@ -0,0 +1,105 @@
+#include "genre_table.h"
+#include <array>
+#include <cstddef>
+using namespace std;
+
+namespace {
+
+struct GenreKey {
+    string_view name; // canonical form, see canonicalChar()
+    GenreCode code;
+};
+
+constexpr GenreKey kGenres[] = {
+    {"hiphop", GenreCode::HipHop},         {"rap", GenreCode::HipHop},
+    {"pop", GenreCode::Pop},               {"rock", GenreCode::Rock},
+    {"electronic", GenreCode::Electronic}, {"edm", GenreCode::Electronic},
+    {"r&b", GenreCode::RnB},               {"soul", GenreCode::RnB},
+    {"indie", GenreCode::Indie},           {"alternative", GenreCode::Indie},
+    {"jazz", GenreCode::Jazz},             {"classical", GenreCode::Classical},
+    {"country", GenreCode::Country},       {"folk", GenreCode::Folk},
+    {"metal", GenreCode::Metal},           {"punk", GenreCode::Punk},
+    {"reggae", GenreCode::Reggae},         {"blues", GenreCode::Blues},
+    {"funk", GenreCode::Funk},             {"disco", GenreCode::Disco},
+    {"latin", GenreCode::Latin},           {"world", GenreCode::World},
+    {"experimental", GenreCode::Experimental}, {"ambient", GenreCode::Ambient},
+};
+
+constexpr const char* kNames[] = {
+    "unknown", "hip-hop", "pop", "rock", "electronic", "r&b", "indie", "jazz", "classical", "country",
+    "folk", "metal", "punk", "reggae", "blues", "funk", "disco", "latin", "world", "experimental", "ambient",
+};
+
+constexpr size_t kMaxKeyLength = 16;
+constexpr size_t kSlots = 64; // power of two, a bit over twice the key count
+
+// lower-case letters and digits are kept, separators dropped (returns 0)
+constexpr char canonicalChar(char c) {
+    if (c >= 'A' && c <= 'Z') return static_cast<char>(c - 'A' + 'a');
+    if (c == ' ' || c == '-' || c == '_' || c == '/' || c == '.') return 0;
+    return c;
+}
+
+// FNV-1a over the canonical text, with a seed folded into the basis
+constexpr uint32_t hashKey(string_view text, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : text) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+constexpr bool collisionFree(uint32_t seed) {
+    array<bool, kSlots> used{};
+    for (const GenreKey& key : kGenres) {
+        size_t slot = hashKey(key.name, seed) & (kSlots - 1);
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+// first seed under which every key gets its own slot
+constexpr uint32_t findSeed() {
+    for (uint32_t seed = 0; seed < 100000; ++seed) {
+        if (collisionFree(seed)) return seed;
+    }
+    return ~uint32_t(0);
+}
+
+constexpr uint32_t kSeed = findSeed();
+static_assert(kSeed != ~uint32_t(0), "no perfect hash seed for the genre table");
+
+// slot -> index into kGenres + 1 (0 = empty)
+constexpr array<uint8_t, kSlots> makeSlots() {
+    array<uint8_t, kSlots> slots{};
+    for (size_t i = 0; i < size(kGenres); ++i) {
+        slots[hashKey(kGenres[i].name, kSeed) & (kSlots - 1)] = static_cast<uint8_t>(i + 1);
+    }
+    return slots;
+}
+constexpr array<uint8_t, kSlots> kSlotTable = makeSlots();
+
+} // namespace
+
+GenreCode encodeGenre(string_view genre) {
+    char buffer[kMaxKeyLength];
+    size_t length = 0;
+    for (char c : genre) {
+        char canonical = canonicalChar(c);
+        if (canonical == 0) continue;
+        if (length == kMaxKeyLength) return GenreCode::Unknown; // longer than any key
+        buffer[length++] = canonical;
+    }
+
+    string_view key(buffer, length);
+    uint8_t entry = kSlotTable[hashKey(key, kSeed) & (kSlots - 1)];
+    if (entry == 0 || kGenres[entry - 1].name != key) return GenreCode::Unknown;
+    return kGenres[entry - 1].code;
+}
+
+const char* genreName(GenreCode code) {
+    size_t index = static_cast<size_t>(code);
+    return index < size(kNames) ? kNames[index] : kNames[0];
+}
@@ -1,123 +1,436 @@
 #include "ml_enhancer.h"
 #include "feature_extractor.h"
+#include "feature_vec.h"
 #include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <limits>
 using namespace std;
 
+namespace {
+
+// Running-mean update: add a point (`width` values) to a centroid that currently averages `size` points
+void addToCentroid(vector<double>& centroid, size_t& size, const double* point, size_t width) {
+    if (size == 0 || centroid.size() != width) {
+        centroid.assign(point, point + width);
+        size = 1;
+        return;
+    }
+    ++size;
+    for (size_t i = 0; i < centroid.size(); ++i) {
+        centroid[i] += (point[i] - centroid[i]) / size;
+    }
+}
+
+// Inverse of addToCentroid; an emptied cluster keeps its last centroid
+void removeFromCentroid(vector<double>& centroid, size_t& size, const double* point, size_t width) {
+    if (size == 0) return;
+    if (size == 1 || centroid.size() != width) {
+        size = (size == 1) ? 0 : size - 1;
+        return;
+    }
+    for (size_t i = 0; i < centroid.size(); ++i) {
+        centroid[i] = (centroid[i] * size - point[i]) / (size - 1);
+    }
+    --size;
+}
+
+// Shared incremental update for the artist and song models
+// (`bound` is the source's id bound, is_live/extract take a dense id;
+// `points` is row-major, `width` values per dense id, updated in place)
+template <typename LiveFn, typename ExtractFn, typename NearestFn>
+void applyIncrementalUpdate(size_t bound,
+                            const vector<DenseId>& upserted,
+                            const vector<DenseId>& removed,
+                            vector<double>& points, size_t width,
+                            vector<int>& clusters,
+                            vector<vector<double>>& centroids,
+                            vector<size_t>& sizes,
+                            LiveFn is_live,
+                            ExtractFn extract,
+                            NearestFn nearest) {
+    if (clusters.size() < bound) {
+        clusters.resize(bound, -1);
+        points.resize(bound * width, 0.0);
+    }
+
+    // Take an item's old contribution out of its cluster
+    auto detach = [&](DenseId id) {
+        if (id >= clusters.size() || clusters[id] < 0) return;
+        double* row = points.data() + size_t(id) * width;
+        removeFromCentroid(centroids[clusters[id]], sizes[clusters[id]], row, width);
+        clusters[id] = -1;
+        fill(row, row + width, 0.0);
+    };
+
+    for (DenseId id : upserted) {
+        if (!is_live(id)) continue; // deleted again later in the same change file
+        detach(id);
+
+        vector<double> features = extract(id);
+        int cluster = nearest(features, centroids);
+        double* row = points.data() + size_t(id) * width;
+        copy(features.begin(), features.end(), row);
+        addToCentroid(centroids[cluster], sizes[cluster], row, width);
+        clusters[id] = cluster;
+    }
+
+    for (DenseId id : removed) detach(id);
+}
+
+// Index of the centroid closest to `point` (first one on ties)
+template <size_t D>
+int nearestFixed(const FeatureVec<D>& point, const vector<FeatureVec<D>>& centroids) {
+    double min_distance = numeric_limits<double>::max();
+    int nearest_cluster = 0;
+    for (size_t i = 0; i < centroids.size(); ++i) {
+        double distance = fixedSquaredDistance<D>(point.data(), centroids[i].data());
+        if (distance < min_distance) {
+            min_distance = distance;
+            nearest_cluster = i;
+        }
+    }
+    return nearest_cluster;
+}
+
+// K-means over rows of a fixed dimension. Same algorithm as the runtime-length
+// path, but centroids are summed in one pass over the points instead of
+// gathering each cluster's points, and no row lives on the heap on its own.
+template <size_t D>
+vector<int> kmeansFixed(const FeatureMatrix<D>& data, int k, mt19937& gen) {
+    int n_points = data.size();
+    
+    // Initialize centroids randomly
+    vector<FeatureVec<D>> centroids(k);
+    uniform_int_distribution<> dis(0, n_points - 1);
+    for (int i = 0; i < k; ++i) {
+        centroids[i] = data[dis(gen)];
+    }
+    
+    vector<int> assignments(n_points, 0);
+    vector<FeatureVec<D>> sums(k);
+    vector<size_t> counts(k);
+    bool converged = false;
+    int max_iterations = 100;
+    int iteration = 0;
+    
+    while (!converged && iteration < max_iterations) {
+        converged = true;
+        
+        // Assign points to nearest centroid
+        for (int i = 0; i < n_points; ++i) {
+            int nearest_cluster = nearestFixed(data[i], centroids);
+            if (assignments[i] != nearest_cluster) {
+                assignments[i] = nearest_cluster;
+                converged = false;
+            }
+        }
+        
+        // Update centroids (points are summed in index order, as calculateCentroid does)
+        fill(sums.begin(), sums.end(), FeatureVec<D>{});
+        fill(counts.begin(), counts.end(), 0);
+        for (int i = 0; i < n_points; ++i) {
+            FeatureVec<D>& sum = sums[assignments[i]];
+            unroll<D>([&](auto d) { sum[d] += data[i][d]; });
+            ++counts[assignments[i]];
+        }
+        for (int cluster = 0; cluster < k; ++cluster) {
+            if (counts[cluster] == 0) continue;
+            FeatureVec<D>& new_centroid = sums[cluster];
+            unroll<D>([&](auto d) { new_centroid[d] /= counts[cluster]; });
+            if (new_centroid.values != centroids[cluster].values) {
+                centroids[cluster] = new_centroid;
+                converged = false;
+            }
+        }
+        
+        iteration++;
+    }
+    
+    return assignments;
+}
+
+// Persisted assignments, if they cover exactly `count` items with the same k
+bool restoreAssignments(const vector<int32_t>& saved, uint32_t clusters, size_t count, int k,
+                        vector<int>& assignments) {
+    if (clusters != static_cast<uint32_t>(k) || saved.size() != count) return false;
+    for (int32_t cluster : saved) {
+        if (cluster < 0 || cluster >= k) return false;
+    }
+    assignments.assign(saved.begin(), saved.end());
+    return true;
+}
+
+// Store a clustering of `ids` (row i of the row-major `data` belongs to ids[i]):
+// centroids as the mean of their rows, summed in one pass in row order, plus
+// the assignment and features of every item by dense id (one row-major matrix)
+void storeClusters(const double* data, size_t width, const vector<DenseId>& ids,
+                   const vector<int>& assignments, int k, size_t bound,
+                   vector<vector<double>>& centroids, vector<size_t>& sizes,
+                   vector<int>& clusters, vector<double>& points) {
+    vector<vector<double>> sums(k, vector<double>(width, 0.0));
+    sizes.assign(k, 0);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const double* row = data + i * width;
+        vector<double>& sum = sums[assignments[i]];
+        for (size_t d = 0; d < width; ++d) sum[d] += row[d];
+        ++sizes[assignments[i]];
+    }
+    
+    centroids.assign(k, vector<double>());
+    for (int cluster = 0; cluster < k; ++cluster) {
+        if (sizes[cluster] == 0) continue; // empty clusters keep no centroid
+        for (double& value : sums[cluster]) value /= sizes[cluster];
+        centroids[cluster] = std::move(sums[cluster]);
+    }
+    
+    clusters.assign(bound, -1);
+    points.assign(bound * width, 0.0);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        clusters[ids[i]] = assignments[i];
+        copy(data + i * width, data + (i + 1) * width, points.begin() + size_t(ids[i]) * width);
+    }
+}
+
+} // namespace
+
 // Constructor
 MLEnhancer::MLEnhancer(int num_clusters) 
     : num_clusters_(num_clusters), 
       artist_model_trained_(false), 
       song_model_trained_(false),
-      gen_(rd_()) {
+      gen_(random_device{}()) {
 }
 
 // Train artist model with K-means clustering
-void MLEnhancer::trainArtistModel(const vector<Artist>& artists) {
+void MLEnhancer::trainArtistModel(const ArtistDatabase& artists, const FeatureStats* stats,
+                                  const ClusterAssignments* saved) {
     if (artists.empty()) {
         cerr << "No artists provided for training" << endl;
         return;
     }
     
-    training_artists_ = artists;
-    
-    // Extract features from all artists
-    vector<vector<double>> features = extractArtistFeatures(artists);
-    
-    // Perform K-means clustering
-    vector<int> cluster_assignments = kmeansClustering(features, num_clusters_);
-    
-    // Store cluster assignments
-    artist_clusters_.clear();
-    for (size_t i = 0; i < artists.size(); ++i) {
-        artist_clusters_[artists[i].id] = cluster_assignments[i];
+    // Extract features from all artists (in dense id order) in one batch
+    vector<DenseId> ids;
+    ids.reserve(artists.size());
+    for (auto it = artists.begin(); it != artists.end(); ++it) ids.push_back(it.id());
+    FeatureExtractor fe;
+    FeatureMatrix<kArtistFeatureDims> features(ids.size());
+    fe.extractRawArtistFeatures(artists, ids, features.data());
+    
+    // Standardize (z-score + L2) in place with the statistics kept by the model
+    if (stats && stats->dims() == kArtistFeatureDims && stats->count() == ids.size()) {
+        artist_stats_ = *stats;
+    } else {
+        artist_stats_ = FeatureStats::compute(features.data()->data(), ids.size(), kArtistFeatureDims);
     }
+    for (auto& row : features) artist_stats_.standardize(row.data(), row.data());
     
-    // Calculate centroids for each cluster
-    artist_centroids_.clear();
-    artist_centroids_.resize(num_clusters_);
+    // Perform K-means clustering, unless the catalog's clustering was persisted
+    vector<int> cluster_assignments;
+    bool restored = saved && restoreAssignments(saved->artists, saved->clusters, ids.size(), num_clusters_,
+                                                cluster_assignments);
+    if (!restored) cluster_assignments = kmeansFixed<kArtistFeatureDims>(features, num_clusters_, gen_);
     
-    for (int cluster = 0; cluster < num_clusters_; ++cluster) {
-        vector<vector<double>> cluster_points;
-        for (size_t i = 0; i < features.size(); ++i) {
-            if (cluster_assignments[i] == cluster) {
-                cluster_points.push_back(features[i]);
-            }
-        }
-        if (!cluster_points.empty()) {
-            artist_centroids_[cluster] = calculateCentroid(cluster_points);
-        }
-    }
+    // Centroids, cluster assignments and features by dense id
+    storeClusters(features.data()->data(), kArtistFeatureDims, ids, cluster_assignments, num_clusters_,
+                  artists.idBound(), artist_centroids_, artist_cluster_sizes_, artist_clusters_.write(), artist_points_.write());
     
     artist_model_trained_ = true;
-    cout << "Artist model trained with " << artists.size() << " artists in " << num_clusters_ << " clusters" << endl;
+    cout << "Artist model " << (restored ? "restored" : "trained") << " with " << artists.size() << " artists in " << num_clusters_ << " clusters" << endl;
 }
 
 // Train song model with K-means clustering
-void MLEnhancer::trainSongModel(const vector<Song>& songs) {
-    if (songs.empty()) {
+void MLEnhancer::trainSongModel(const SongStore& songs, const ClusterAssignments* saved) {
+    if (songs.liveCount() == 0) {
         cerr << "No songs provided for training" << endl;
         return;
     }
     
-    training_songs_ = songs;
-    
-    // Extract features from all songs
-    vector<vector<double>> features = extractSongFeatures(songs);
-    
-    // Perform K-means clustering
-    vector<int> cluster_assignments = kmeansClustering(features, num_clusters_);
-    
-    // Store cluster assignments
-    song_clusters_.clear();
-    for (size_t i = 0; i < songs.size(); ++i) {
-        song_clusters_[songs[i].id] = cluster_assignments[i];
+    // Extract features from all songs in one batch (one sequential pass over the store);
+    // rows are as wide as the longest song, shorter songs end in zeros
+    vector<DenseId> rows;
+    rows.reserve(songs.liveCount());
+    size_t max_dims = 0;
+    for (DenseId row = 0; row < songs.rows(); ++row) {
+        if (!songs.isLive(row)) continue;
+        rows.push_back(row);
+        max_dims = max(max_dims, songs.featureCount(row));
     }
+    song_width_ = max_dims + 2;
+    vector<double> features = extractSongFeatures(songs, rows, song_width_);
     
-    // Calculate centroids for each cluster
-    song_centroids_.clear();
-    song_centroids_.resize(num_clusters_);
+    // Perform K-means clustering, unless the catalog's clustering was persisted
+    vector<int> cluster_assignments;
+    bool restored = saved && restoreAssignments(saved->songs, saved->clusters, rows.size(), num_clusters_,
+                                                cluster_assignments);
+    if (!restored) cluster_assignments = kmeansClustering(features, song_width_, num_clusters_);
     
-    for (int cluster = 0; cluster < num_clusters_; ++cluster) {
-        vector<vector<double>> cluster_points;
-        for (size_t i = 0; i < features.size(); ++i) {
-            if (cluster_assignments[i] == cluster) {
-                cluster_points.push_back(features[i]);
-            }
-        }
-        if (!cluster_points.empty()) {
-            song_centroids_[cluster] = calculateCentroid(cluster_points);
-        }
-    }
+    // Centroids, cluster assignments and features by dense id
+    storeClusters(features.data(), song_width_, rows, cluster_assignments, num_clusters_,
+                  songs.rows(), song_centroids_, song_cluster_sizes_, song_clusters_.write(), song_points_.write());
     
     song_model_trained_ = true;
-    cout << "Song model trained with " << songs.size() << " songs in " << num_clusters_ << " clusters" << endl;
+    cout << "Song model " << (restored ? "restored" : "trained") << " with " << songs.liveCount() << " songs in " << num_clusters_ << " clusters" << endl;
 }
 
-// Extract features from artists
-vector<vector<double>> MLEnhancer::extractArtistFeatures(const vector<Artist>& artists) {
-    FeatureExtractor fe;
-    vector<vector<double>> features;
+ClusterAssignments MLEnhancer::exportClusters(const ArtistDatabase& artists, const SongStore& songs) const {
+    ClusterAssignments clusters;
+    if ((!artists.empty() && !artist_model_trained_) || (songs.liveCount() > 0 && !song_model_trained_)) {
+        return clusters;
+    }
     
-    for (const auto& artist : artists) {
-        features.push_back(fe.extractArtistFeatures(artist));
+    // Live items in dense id order, as the snapshot writes them
+    for (auto it = artists.begin(); it != artists.end(); ++it) {
+        int cluster = getArtistCluster(it.id());
+        if (cluster < 0) return ClusterAssignments();
+        clusters.artists.push_back(cluster);
+    }
+    for (DenseId row = 0; row < songs.rows(); ++row) {
+        if (!songs.isLive(row)) continue;
+        int cluster = getSongCluster(row);
+        if (cluster < 0) return ClusterAssignments();
+        clusters.songs.push_back(cluster);
+    }
+    clusters.clusters = num_clusters_;
+    return clusters;
+}
+
+void MLEnhancer::save(BlobWriter& out) const {
+    out.value<int32_t>(num_clusters_);
+    out.value<uint8_t>(artist_model_trained_);
+    out.value<uint8_t>(song_model_trained_);
+    out.value<uint64_t>(song_width_);
+    for (const auto* centroids : {&artist_centroids_, &song_centroids_}) {
+        out.value<uint64_t>(centroids->size());
+        for (const auto& centroid : *centroids) out.array(centroid);
     }
+    out.array(artist_cluster_sizes_);
+    out.array(song_cluster_sizes_);
+    out.array(*artist_clusters_);
+    out.array(*song_clusters_);
+    out.array(*artist_points_);
+    out.array(*song_points_);
+    artist_stats_.save(out);
+}
+
+bool MLEnhancer::load(BlobReader& in) {
+    int32_t clusters = 0;
+    uint8_t artist_trained = 0, song_trained = 0;
+    uint64_t song_width = 0;
+    if (!in.value(clusters) || clusters != num_clusters_) return in.fail();
+    in.value(artist_trained);
+    in.value(song_trained);
+    in.value(song_width);
+    for (auto* centroids : {&artist_centroids_, &song_centroids_}) {
+        uint64_t count = 0;
+        if (!in.value(count) || count != static_cast<uint64_t>(num_clusters_)) return in.fail();
+        centroids->assign(count, vector<double>());
+        for (auto& centroid : *centroids) in.array(centroid);
+    }
+    in.array(artist_cluster_sizes_);
+    in.array(song_cluster_sizes_);
+    vector<int>& artist_clusters = artist_clusters_.write();
+    vector<int>& song_clusters = song_clusters_.write();
+    vector<double>& artist_points = artist_points_.write();
+    vector<double>& song_points = song_points_.write();
+    in.array(artist_clusters);
+    in.array(song_clusters);
+    in.array(artist_points);
+    in.array(song_points);
+    artist_stats_.load(in);
+
+    // every assignment names a cluster, and every point row is as wide as the model
+    auto inRange = [this](const vector<int>& assignments) {
+        return all_of(assignments.begin(), assignments.end(),
+                      [this](int cluster) { return cluster >= -1 && cluster < num_clusters_; });
+    };
+    bool ok = in.ok() && artist_cluster_sizes_.size() == size_t(num_clusters_) &&
+              song_cluster_sizes_.size() == size_t(num_clusters_) &&
+              artist_points.size() == artist_clusters.size() * kArtistFeatureDims &&
+              song_points.size() == song_clusters.size() * song_width &&
+              inRange(artist_clusters) && inRange(song_clusters);
+    for (const auto& centroid : artist_centroids_) ok = ok && (centroid.empty() || centroid.size() == kArtistFeatureDims);
+    for (const auto& centroid : song_centroids_) ok = ok && (centroid.empty() || centroid.size() == song_width);
+    if (!ok) {
+        artist_model_trained_ = song_model_trained_ = false;
+        return in.fail();
+    }
+    artist_model_trained_ = artist_trained != 0;
+    song_model_trained_ = song_trained != 0;
+    song_width_ = song_width;
+    return true;
+}
+
+// Fold upserted/removed artists into the trained model
+void MLEnhancer::updateArtists(const ArtistDatabase& artists, const vector<DenseId>& upserted,
+                               const vector<DenseId>& removed) {
+    if (!artist_model_trained_) return;
+    
+    applyIncrementalUpdate(artists.idBound(), upserted, removed, artist_points_.write(), kArtistFeatureDims, artist_clusters_.write(),
+        artist_centroids_, artist_cluster_sizes_,
+        [&](DenseId id) { return artists.contains(id); },
+        [&](DenseId id) { return extractArtistFeatures(artists[id]); },
+        [this](const vector<double>& point, const vector<vector<double>>& centroids) {
+            return findNearestCentroid(point, centroids);
+        });
+}
+
+// Fold upserted/removed songs into the trained model
+void MLEnhancer::updateSongs(const SongStore& songs, const vector<DenseId>& upserted,
+                             const vector<DenseId>& removed) {
+    if (!song_model_trained_) return;
     
-    return features;
+    FeatureExtractor fe;
+    applyIncrementalUpdate(songs.rows(), upserted, removed, song_points_.write(), song_width_, song_clusters_.write(),
+        song_centroids_, song_cluster_sizes_,
+        [&](DenseId id) { return songs.isLive(id); },
+        [&](DenseId id) {
+            vector<double> point(song_width_);
+            fe.extractSongFeatures(songs, {id}, point.data(), point.size(), 1);
+            return point;
+        },
+        [this](const vector<double>& point, const vector<vector<double>>& centroids) {
+            return findNearestCentroid(point, centroids);
+        });
+}
+
+// Extract one artist's features in the model's standardized space
+vector<double> MLEnhancer::extractArtistFeatures(const Artist& artist) {
+    FeatureExtractor fe;
+    ArtistFeatures features = fe.extractRawArtistFeatures(artist);
+    artist_stats_.standardize(features.data(), features.data());
+    return features.toVector();
 }
 
 // Extract features from songs
-vector<vector<double>> MLEnhancer::extractSongFeatures(const vector<Song>& songs) {
+vector<double> MLEnhancer::extractSongFeatures(const SongStore& songs, const vector<DenseId>& rows, size_t width) {
     FeatureExtractor fe;
-    vector<vector<double>> features;
-    
-    for (const auto& song : songs) {
-        features.push_back(fe.extractSongFeatures(song));
+    vector<double> features(rows.size() * width);
+    fe.extractSongFeatures(songs, rows, features.data(), width);
+    return features;
+}
+
+// K-means over a row-major matrix: small widths run the fixed-dimension kernel
+// (the width is dispatched once), wider rows the runtime-length one
+vector<int> MLEnhancer::kmeansClustering(const vector<double>& data, size_t width, int k) {
+    size_t n_points = width > 0 ? data.size() / width : 0;
+    vector<int> fixed_assignments;
+    if (n_points > 0 && dispatchFeatureDims(width, [&](auto dims) {
+            FeatureMatrix<dims> matrix(n_points);
+            for (size_t i = 0; i < n_points; ++i) {
+                copy(data.begin() + i * width, data.begin() + (i + 1) * width, matrix[i].values.begin());
+            }
+            fixed_assignments = kmeansFixed<dims>(matrix, k, gen_);
+        })) {
+        return fixed_assignments;
     }
     
-    return features;
+    vector<vector<double>> rows(n_points);
+    for (size_t i = 0; i < n_points; ++i) {
+        rows[i].assign(data.begin() + i * width, data.begin() + (i + 1) * width);
+    }
+    return kmeansClustering(rows, k);
 }
 
 // K-means clustering algorithm
@@ -129,6 +442,22 @@ vector<int> MLEnhancer::kmeansClustering(const vector<vector<double>>& data, int
     int n_points = data.size();
     int n_features = data[0].size();
     
+    // Rows of one shared, small dimension (every artist catalog, and song catalogs
+    // whose songs all carry the same number of features) run the fixed-dimension
+    // kernel; the dimension is dispatched once for the whole catalog
+    bool uniform = all_of(data.begin(), data.end(),
+        [&](const vector<double>& row) { return row.size() == data[0].size(); });
+    vector<int> fixed_assignments;
+    if (uniform && dispatchFeatureDims(n_features, [&](auto dims) {
+            FeatureMatrix<dims> matrix(n_points);
+            for (int i = 0; i < n_points; ++i) {
+                copy(data[i].begin(), data[i].end(), matrix[i].values.begin());
+            }
+            fixed_assignments = kmeansFixed<dims>(matrix, k, gen_);
+        })) {
+        return fixed_assignments;
+    }
+    
     // Initialize centroids randomly
     vector<vector<double>> centroids(k, vector<double>(n_features));
     uniform_int_distribution<> dis(0, n_points - 1);
@@ -236,8 +565,7 @@ int MLEnhancer::findNearestCentroid(const vector<double>& point, const vector<ve
 // Enhance artist recommendations using ML
 vector<RecommendationResult> MLEnhancer::enhanceArtistRecommendations(
     const vector<RecommendationResult>& base_recommendations,
-    const Artist& input_artist,
-    const ArtistDatabase& artists) {
+    const Artist& input_artist) {
     
     if (!artist_model_trained_) {
         return base_recommendations; // Return original if model not trained
@@ -246,24 +574,15 @@ vector<RecommendationResult> MLEnhancer::enhanceArtistRecommendations(
     vector<RecommendationResult> enhanced = base_recommendations;
     
     // Get input artist's cluster
-    FeatureExtractor fe;
-    vector<double> input_features = fe.extractArtistFeatures(input_artist);
+    vector<double> input_features = extractArtistFeatures(input_artist);
     int input_cluster = findNearestCentroid(input_features, artist_centroids_);
     
     // Boost recommendations from the same cluster
     for (auto& rec : enhanced) {
-        // Find the artist in our database
-        auto it = find_if(artists.begin(), artists.end(),
-            [&](const auto& pair) { return pair.second.name == rec.artist_name; });
-        
-        if (it != artists.end()) {
-            int rec_cluster = getArtistCluster(it->second);
-            
-            // Boost score if in same cluster
-            if (rec_cluster == input_cluster) {
-                rec.adjusted_score *= 1.2; // 20% boost
-                rec.reason += " (Same cluster)";
-            }
+        // Boost score if in same cluster
+        if (getArtistCluster(rec.item_id) == input_cluster) {
+            rec.adjusted_score *= 1.2; // 20% boost
+            rec.reason += " (Same cluster)";
         }
     }
     
@@ -277,34 +596,26 @@ vector<RecommendationResult> MLEnhancer::enhanceArtistRecommendations(
 // Enhance song recommendations using ML
 vector<RecommendationResult> MLEnhancer::enhanceSongRecommendations(
     const vector<RecommendationResult>& base_recommendations,
-    const Song& input_song,
-    const SongDatabase& songs) {
+    const SongStore& songs, DenseId input_row) {
     
-    if (!song_model_trained_) {
+    if (!song_model_trained_ || !songs.isLive(input_row)) {
         return base_recommendations; // Return original if model not trained
     }
     
     vector<RecommendationResult> enhanced = base_recommendations;
     
-    // Get input song's cluster
+    // Get input song's cluster, from a row extracted like the training rows
     FeatureExtractor fe;
-    vector<double> input_features = fe.extractSongFeatures(input_song);
+    vector<double> input_features(song_width_);
+    fe.extractSongFeatures(songs, {input_row}, input_features.data(), song_width_, 1);
     int input_cluster = findNearestCentroid(input_features, song_centroids_);
     
     // Boost recommendations from the same cluster
     for (auto& rec : enhanced) {
-        // Find the song in our database
-        auto it = find_if(songs.begin(), songs.end(),
-            [&](const auto& pair) { return pair.second.name == rec.song_title; });
-        
-        if (it != songs.end()) {
-            int rec_cluster = getSongCluster(it->second);
-            
-            // Boost score if in same cluster
-            if (rec_cluster == input_cluster) {
-                rec.adjusted_score *= 1.2; // 20% boost
-                rec.reason += " (Same cluster)";
-            }
+        // Boost score if in same cluster
+        if (getSongCluster(rec.item_id) == input_cluster) {
+            rec.adjusted_score *= 1.2; // 20% boost
+            rec.reason += " (Same cluster)";
         }
     }
     
@@ -316,24 +627,22 @@ vector<RecommendationResult> MLEnhancer::enhanceSongRecommendations(
 }
 
 // Get artist's cluster
-int MLEnhancer::getArtistCluster(const Artist& artist) const {
-    auto it = artist_clusters_.find(artist.id);
-    return (it != artist_clusters_.end()) ? it->second : -1;
+int MLEnhancer::getArtistCluster(DenseId artist) const {
+    return artist < artist_clusters_->size() ? (*artist_clusters_)[artist] : -1;
 }
 
 // Get song's cluster
-int MLEnhancer::getSongCluster(const Song& song) const {
-    auto it = song_clusters_.find(song.id);
-    return (it != song_clusters_.end()) ? it->second : -1;
+int MLEnhancer::getSongCluster(DenseId song) const {
+    return song < song_clusters_->size() ? (*song_clusters_)[song] : -1;
 }
 
 // Get artists in a specific cluster
-vector<Artist> MLEnhancer::getArtistsInCluster(int cluster_id) const {
-    vector<Artist> cluster_artists;
+vector<DenseId> MLEnhancer::getArtistsInCluster(int cluster_id) const {
+    vector<DenseId> cluster_artists;
     
-    for (const auto& artist : training_artists_) {
-        if (getArtistCluster(artist) == cluster_id) {
-            cluster_artists.push_back(artist);
+    for (DenseId id = 0; id < artist_clusters_->size(); ++id) {
+        if ((*artist_clusters_)[id] == cluster_id) {
+            cluster_artists.push_back(id);
         }
     }
     
@@ -341,14 +650,14 @@ vector<Artist> MLEnhancer::getArtistsInCluster(int cluster_id) const {
 }
 
 // Get songs in a specific cluster
-vector<Song> MLEnhancer::getSongsInCluster(int cluster_id) const {
-    vector<Song> cluster_songs;
+vector<DenseId> MLEnhancer::getSongsInCluster(int cluster_id) const {
+    vector<DenseId> cluster_songs;
     
-    for (const auto& song : training_songs_) {
-        if (getSongCluster(song) == cluster_id) {
-            cluster_songs.push_back(song);
+    for (DenseId id = 0; id < song_clusters_->size(); ++id) {
+        if ((*song_clusters_)[id] == cluster_id) {
+            cluster_songs.push_back(id);
         }
     }
     
     return cluster_songs;
-} 
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "name_index.h"
+#include <algorithm>
+using namespace std;
+
+string NameIndex::normalize(string_view name) {
+    string key;
+    key.reserve(name.size());
+    bool pending_space = false;
+    for (char c : name) {
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            pending_space = !key.empty();
+            continue;
+        }
+        if (pending_space) key.push_back(' ');
+        pending_space = false;
+        key.push_back((c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c);
+    }
+    return key;
+}
+
+const vector<DenseId>& NameIndex::find(string_view name) const {
+    static const vector<DenseId> kNoMatches;
+    auto it = ids_by_name_.find(normalize(name));
+    return it != ids_by_name_.end() ? it->second : kNoMatches;
+}
+
+NameIndex& NameIndex::operator=(const NameIndex& other) {
+    if (this == &other) return *this;
+    ids_by_name_ = other.ids_by_name_;
+    name_of_.assign(other.name_of_.size(), nullptr);
+    for (const auto& [key, ids] : ids_by_name_) {
+        for (DenseId id : ids) name_of_[id] = &key;
+    }
+    return *this;
+}
+
+void NameIndex::clear() {
+    ids_by_name_.clear();
+    name_of_.clear();
+}
+
+void NameIndex::save(BlobWriter& out) const {
+    out.value<uint64_t>(name_of_.size());
+    out.value<uint64_t>(ids_by_name_.size());
+    for (const auto& [key, ids] : ids_by_name_) {
+        out.text(key);
+        out.array(ids);
+    }
+}
+
+bool NameIndex::load(BlobReader& in, size_t id_bound) {
+    clear();
+    uint64_t bound = 0, names = 0;
+    if (!in.value(bound) || !in.value(names) || bound != id_bound || names > bound) return in.fail();
+    name_of_.assign(bound, nullptr);
+    ids_by_name_.reserve(names);
+    string key;
+    vector<DenseId> ids;
+    for (uint64_t i = 0; i < names && in.ok(); ++i) {
+        if (!in.text(key) || !in.array(ids)) break;
+        auto [it, inserted] = ids_by_name_.try_emplace(std::move(key), std::move(ids));
+        for (DenseId id : it->second) {
+            if (!inserted || id >= bound || name_of_[id] != nullptr) {
+                in.fail();
+                break;
+            }
+            name_of_[id] = &it->first;
+        }
+    }
+    if (!in.ok()) clear();
+    return in.ok();
+}
+
+void NameIndex::add(DenseId id, const string& name) {
+    auto it = ids_by_name_.try_emplace(normalize(name)).first;
+    vector<DenseId>& ids = it->second;
+    ids.insert(lower_bound(ids.begin(), ids.end(), id), id);
+    name_of_[id] = &it->first;
+}
+
+void NameIndex::remove(DenseId id) {
+    if (id >= name_of_.size() || name_of_[id] == nullptr) return;
+
+    auto it = ids_by_name_.find(*name_of_[id]);
+    name_of_[id] = nullptr;
+    if (it == ids_by_name_.end()) return;
+
+    vector<DenseId>& ids = it->second;
+    auto pos = lower_bound(ids.begin(), ids.end(), id);
+    if (pos != ids.end() && *pos == id) ids.erase(pos);
+    if (ids.empty()) ids_by_name_.erase(it);
+}
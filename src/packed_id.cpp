@@ -0,0 +1,131 @@
+#include "packed_id.h"
+#include "symbol_table.h"
+#include <array>
+#include <charconv>
+using namespace std;
+
+namespace {
+
+using uint128 = unsigned __int128;
+
+constexpr char kAlphabet[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+constexpr uint64_t kPow62_10 = 839299365868340224ull; // 62^10, largest power below 2^60
+
+// character -> base62 digit, 0xff for anything else
+constexpr array<uint8_t, 256> makeDigits() {
+    array<uint8_t, 256> digits{};
+    for (auto& digit : digits) digit = 0xff;
+    for (uint8_t i = 0; i < 62; ++i) digits[static_cast<uint8_t>(kAlphabet[i])] = i;
+    return digits;
+}
+constexpr array<uint8_t, 256> kDigits = makeDigits();
+
+// `count` base62 digits as one integer (count <= 10 keeps it below 2^60)
+bool decodeChunk(const char* text, size_t count, uint64_t& value) {
+    value = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t digit = kDigits[static_cast<uint8_t>(text[i])];
+        if (digit == 0xff) return false;
+        value = value * 62 + digit;
+    }
+    return true;
+}
+
+void encodeChunk(uint64_t value, char* out, size_t count) {
+    for (size_t i = count; i-- > 0;) {
+        out[i] = kAlphabet[value % 62];
+        value /= 62;
+    }
+}
+
+// Ids that fit neither packed form; separate from the genre/tag pool so its
+// statistics stay about genres and tags
+SymbolTable& otherIds() {
+    static SymbolTable table;
+    return table;
+}
+
+} // namespace
+
+bool PackedId::fromBase62(string_view text, PackedId& id) {
+    if (text.size() != kBase62Length) return false;
+
+    // 2 + 10 + 10 digits, each chunk decoded in 64-bit arithmetic
+    uint64_t head, middle, tail;
+    if (!decodeChunk(text.data(), 2, head) || !decodeChunk(text.data() + 2, 10, middle) ||
+        !decodeChunk(text.data() + 12, 10, tail)) {
+        return false;
+    }
+
+    // head * 62^20 + middle * 62^10 + tail must stay below 2^128
+    const uint128 pow20 = static_cast<uint128>(kPow62_10) * kPow62_10;
+    uint128 value;
+    if (__builtin_mul_overflow(static_cast<uint128>(head), pow20, &value) ||
+        __builtin_add_overflow(value, static_cast<uint128>(middle) * kPow62_10 + tail, &value)) {
+        return false;
+    }
+
+    uint64_t high = static_cast<uint64_t>(value >> 64);
+    if (high >= kOtherTag) return false; // reserved for the fallbacks
+    id = PackedId(high, static_cast<uint64_t>(value));
+    return true;
+}
+
+// Base62 or numeric form of `text`, if it has one
+bool PackedId::packInline(string_view text, PackedId& id) {
+    if (fromBase62(text, id)) return true;
+
+    // Canonical decimal (no sign, no leading zeros) that fits 64 bits
+    uint64_t number = 0;
+    bool canonical = !text.empty() && text.size() <= 20 && (text[0] != '0' || text.size() == 1);
+    if (canonical) {
+        auto [end, ec] = from_chars(text.data(), text.data() + text.size(), number);
+        if (ec == errc() && end == text.data() + text.size()) {
+            id = PackedId(kNumericTag, number);
+            return true;
+        }
+    }
+    return false;
+}
+
+PackedId PackedId::parse(string_view text) {
+    PackedId id;
+    if (packInline(text, id)) return id;
+    return PackedId(kOtherTag, otherIds().intern(text));
+}
+
+bool PackedId::find(string_view text, PackedId& id) {
+    if (packInline(text, id)) return true;
+    Symbol symbol;
+    if (!otherIds().find(text, symbol)) return false;
+    id = PackedId(kOtherTag, symbol);
+    return true;
+}
+
+PackedId::Kind PackedId::kind() const {
+    if (high_ == kNumericTag) return Kind::Numeric;
+    if (high_ == kOtherTag) return Kind::Other;
+    return Kind::Base62;
+}
+
+string PackedId::str() const {
+    switch (kind()) {
+        case Kind::Numeric:
+            return to_string(low_);
+        case Kind::Other:
+            return otherIds().str(static_cast<Symbol>(low_));
+        case Kind::Base62:
+            break;
+    }
+
+    uint128 value = (static_cast<uint128>(high_) << 64) | low_;
+    const uint128 pow20 = static_cast<uint128>(kPow62_10) * kPow62_10;
+    uint64_t head = static_cast<uint64_t>(value / pow20);
+    value %= pow20;
+
+    string text(kBase62Length, '0');
+    encodeChunk(head, &text[0], 2);
+    encodeChunk(static_cast<uint64_t>(value / kPow62_10), &text[2], 10);
+    encodeChunk(static_cast<uint64_t>(value % kPow62_10), &text[12], 10);
+    return text;
+}
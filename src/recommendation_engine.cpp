@@ -1,37 +1,355 @@
 #include "recommendation_engine.h"
 #include <algorithm>
+#include <numeric>
+#include <cmath>
 #include <iostream>
 using namespace std;
 
+namespace {
+
+// Reference cosine over Song records (a shorter vector counts as zero padded,
+// as in the song store)
+double recordCosine(const vector<double>& a, const vector<double>& b, double norm_a) {
+    double dot = 0.0, sum_b = 0.0;
+    for (size_t d = 0; d < b.size(); ++d) {
+        if (d < a.size()) dot += a[d] * b[d];
+        sum_b += b[d] * b[d];
+    }
+    if (norm_a == 0 || sum_b == 0) return 0.0;
+    return dot / (norm_a * sqrt(sum_b));
+}
+
+// Normalized names of the changed records before `names` is updated: their
+// old names lose the records, and upserted ones may have been renamed
+vector<string> touchedNames(const NameIndex& names, const vector<DenseId>& upserted, const vector<DenseId>& deleted) {
+    vector<string> touched;
+    for (const auto* ids : {&upserted, &deleted}) {
+        for (DenseId id : *ids) {
+            if (const string* key = names.keyOf(id)) touched.push_back(*key);
+        }
+    }
+    return touched;
+}
+
+// Re-rank the touched names in the search index from every record that now
+// carries one of them, or rebuild it once the overlay has grown too large
+template <typename Database>
+void patchSearch(SearchIndex& search, const NameIndex& names, const Database& db, vector<string> touched,
+                 const vector<DenseId>& upserted) {
+    for (DenseId id : upserted) {
+        if (db.contains(id)) touched.push_back(NameIndex::normalize(db[id].name));
+    }
+    sort(touched.begin(), touched.end());
+    touched.erase(unique(touched.begin(), touched.end()), touched.end());
+
+    vector<pair<string_view, double>> records;
+    for (const string& key : touched) {
+        for (DenseId id : names.find(key)) records.emplace_back(db[id].name, db[id].popularity_score);
+    }
+    search.patch(touched, records);
+    if (search.overlayFull()) search.build(db);
+}
+
+} // namespace
+
 // Constructor
 RecommendationEngine::RecommendationEngine() : ml_enhancer_(8) {
     // Initialize with 8 clusters for K-means
 }
 
+// Index names and copy the songs into the structure-of-arrays store
+void RecommendationEngine::indexCatalog(const ArtistDatabase& artists, const SongDatabase& songs, uint64_t version) {
+    artist_tags_.write().build(artists);
+    artist_tag_index_.write().build(artists);
+    cacheArtistFeatures(artists);
+    artist_names_.write().build(artists);
+    song_names_.write().build(songs);
+    artist_search_.write().build(artists);
+    song_search_.write().build(songs);
+    song_store_.write().build(songs, artists);
+    artist_songs_.write().build(artists, songs);
+    catalog_version_ = version;
+}
+
+namespace {
+
+constexpr uint64_t kIndexMagic = 0x3158444e49524d; // "MRINDX1"
+constexpr uint32_t kIndexVersion = 1;
+
+} // namespace
+
+// Indexes in a fixed order behind a header naming the catalog shape they index
+string RecommendationEngine::saveIndexes() const {
+    BlobWriter out;
+    out.value(kIndexMagic);
+    out.value(kIndexVersion);
+    out.value<uint64_t>(artist_raw_features_->size());
+    out.value<uint64_t>(song_store_->rows());
+    out.value<uint64_t>(SymbolTable::global().size());
+
+    artist_tags_->save(out);
+    if (!artist_tag_index_->save(out)) return string();
+    out.array(*artist_raw_features_);
+    out.array(*artist_features_);
+    out.array(*artist_counted_);
+    artist_stats_.save(out);
+    artist_names_->save(out);
+    song_names_->save(out);
+    if (!artist_search_->save(out) || !song_search_->save(out)) return string();
+    song_store_->save(out);
+    if (!artist_songs_->save(out)) return string();
+    ml_enhancer_.save(out);
+    return out.release();
+}
+
+// Restore the indexes (and models) of a freshly loaded catalog; the song store
+// is rebuilt alone when it was saved in another precision
+bool RecommendationEngine::loadIndexes(string_view blob, const ArtistDatabase& artists, const SongDatabase& songs,
+                                       uint64_t version) {
+    BlobReader in(blob);
+    uint64_t magic = 0, artist_bound = 0, song_bound = 0, symbols = 0;
+    uint32_t format = 0;
+    in.value(magic);
+    in.value(format);
+    in.value(artist_bound);
+    in.value(song_bound);
+    in.value(symbols);
+    if (!in.ok() || magic != kIndexMagic || format != kIndexVersion || artist_bound != artists.idBound() ||
+        song_bound != songs.idBound() || symbols > SymbolTable::global().size()) {
+        return false;
+    }
+
+    artist_tags_.write().load(in);
+    artist_tag_index_.write().load(in);
+    in.array(artist_raw_features_.write());
+    in.array(artist_features_.write());
+    in.array(artist_counted_.write());
+    artist_stats_.load(in);
+    artist_names_.write().load(in, artist_bound);
+    song_names_.write().load(in, song_bound);
+    artist_search_.write().load(in);
+    song_search_.write().load(in);
+    bool store_loaded = song_store_.write().load(in);
+    artist_songs_.write().load(in);
+    ml_enhancer_.load(in);
+
+    bool ok = in.atEnd() && artist_tags_->rows() == artist_bound && artist_tag_index_->artistBound() == artist_bound &&
+              artist_raw_features_->size() == artist_bound && artist_features_->size() == artist_bound &&
+              artist_counted_->size() == artist_bound && artist_names_->idBound() == artist_bound &&
+              song_names_->idBound() == song_bound && artist_songs_->artistBound() == artist_bound &&
+              (!store_loaded || song_store_->rows() == song_bound);
+    if (!ok) return false;
+
+    if (!store_loaded) song_store_.write().build(songs, artists);
+    catalog_version_ = version;
+    return true;
+}
+
+// Rebuild the song store with another element type
+void RecommendationEngine::setFeaturePrecision(FeaturePrecision precision, const ArtistDatabase& artists,
+                                               const SongDatabase& songs) {
+    SongStore& store = song_store_.write();
+    store.setPrecision(precision);
+    store.build(songs, artists);
+}
+
+// Rank every song against evenly spaced query songs twice, from the song store
+// and in double precision from the records, and keep the worst deviations
+PrecisionReport RecommendationEngine::checkFeaturePrecision(const SongDatabase& songs, size_t queries, size_t top_k) {
+    PrecisionReport report;
+    report.precision = song_store_->precision();
+    report.top_k = top_k;
+    if (song_store_->rows() != songs.idBound() || songs.size() < 2 || top_k == 0) return report;
+
+    vector<DenseId> live;
+    live.reserve(songs.size());
+    for (auto it = songs.begin(); it != songs.end(); ++it) live.push_back(it.id());
+
+    size_t step = max<size_t>(1, live.size() / max<size_t>(1, queries));
+    vector<float> query(song_store_->stride());
+    vector<double> store_scores;
+    vector<double> exact_scores(songs.idBound(), 0.0);
+    vector<DenseId> exact_order, store_order;
+    vector<size_t> store_rank(songs.idBound(), 0);
+
+    for (size_t q = 0; q < live.size() && report.queries < queries; q += step) {
+        DenseId input_id = live[q];
+        const vector<double>& input = songs[input_id].features;
+        double input_norm = 0.0;
+        for (double value : input) input_norm += value * value;
+        input_norm = sqrt(input_norm);
+
+        song_store_->copyFeatures(input_id, query.data());
+        similarity_calc_.calculateSongSimilarities(*song_store_, query.data(), store_scores);
+
+        exact_order.clear();
+        for (DenseId id : live) {
+            if (id == input_id) continue;
+            exact_scores[id] = recordCosine(input, songs[id].features, input_norm);
+            report.max_score_error = max(report.max_score_error, fabs(store_scores[id] - exact_scores[id]));
+            exact_order.push_back(id);
+        }
+        store_order = exact_order;
+
+        // Highest score first, ties by id, so both orders are deterministic
+        auto by = [](const vector<double>& scores) {
+            return [&scores](DenseId a, DenseId b) {
+                return scores[a] != scores[b] ? scores[a] > scores[b] : a < b;
+            };
+        };
+        size_t k = min(top_k, exact_order.size());
+        partial_sort(exact_order.begin(), exact_order.begin() + k, exact_order.end(), by(exact_scores));
+        sort(store_order.begin(), store_order.end(), by(store_scores));
+        for (size_t rank = 0; rank < store_order.size(); ++rank) store_rank[store_order[rank]] = rank;
+
+        size_t kept = 0;
+        for (size_t rank = 0; rank < k; ++rank) {
+            size_t shifted = store_rank[exact_order[rank]];
+            report.max_rank_shift = max(report.max_rank_shift, shifted > rank ? shifted - rank : rank - shifted);
+            if (shifted < k) ++kept;
+        }
+        report.min_top_k_overlap = min(report.min_top_k_overlap, static_cast<double>(kept) / k);
+        ++report.queries;
+    }
+    return report;
+}
+
+// Extract every artist's features once per catalog version, gather their
+// per-dimension statistics in one parallel pass, and cache the rows z-scored
+// and normalized (tag diversity is the popcount of the artist's tag row)
+void RecommendationEngine::cacheArtistFeatures(const ArtistDatabase& artists) {
+    vector<DenseId> ids(artists.idBound());
+    iota(ids.begin(), ids.end(), DenseId(0));
+    auto& raw = artist_raw_features_.write();
+    raw.resize(ids.size());
+    feature_extractor_.extractRawArtistFeatures(artists, ids, raw.data(), &*artist_tags_);
+
+    vector<uint8_t>& counted = artist_counted_.write();
+    counted.assign(ids.size(), 0);
+    for (auto it = artists.begin(); it != artists.end(); ++it) counted[it.id()] = 1;
+    artist_stats_ = FeatureStats::compute(raw.data()->data(), ids.size(), kArtistFeatureDims, counted.data());
+    standardizeArtistFeatures();
+}
+
+// Re-extract changed rows and move the statistics by their old and new values
+// (no pass over the catalog); erased artists get a zero row
+void RecommendationEngine::refreshArtistFeatures(const ArtistDatabase& artists, const vector<DenseId>& upserted_ids,
+                                                 const vector<DenseId>& deleted_ids) {
+    auto& raw = artist_raw_features_.write();
+    vector<uint8_t>& counted = artist_counted_.write();
+    if (raw.size() < artists.idBound()) {
+        raw.resize(artists.idBound());
+        counted.resize(artists.idBound(), 0);
+    }
+    auto refresh = [&](DenseId id) {
+        if (counted[id]) artist_stats_.remove(raw[id].data());
+        if (artists.contains(id)) {
+            raw[id] = feature_extractor_.extractRawArtistFeatures(artists[id], artist_tags_->count(id));
+            artist_stats_.add(raw[id].data());
+            counted[id] = 1;
+        } else {
+            raw[id] = ArtistFeatures{};
+            counted[id] = 0;
+        }
+    };
+    for (DenseId id : upserted_ids) refresh(id);
+    for (DenseId id : deleted_ids) refresh(id);
+
+    // The means moved, so every cached row is re-standardized here, once per
+    // published version, and queries keep scoring plain dot products
+    standardizeArtistFeatures();
+}
+
+// Fused z-score + L2 over the cached raw rows
+void RecommendationEngine::standardizeArtistFeatures() {
+    // every row is rewritten, so a fresh matrix replaces the shared one
+    const auto& raw = *artist_raw_features_;
+    FeatureMatrix<kArtistFeatureDims> features(raw.size());
+    for (size_t id = 0; id < raw.size(); ++id) {
+        if ((*artist_counted_)[id]) artist_stats_.standardize(raw[id].data(), features[id].data());
+    }
+    artist_features_ = CowPtr<FeatureMatrix<kArtistFeatureDims>>(std::move(features));
+}
+
+// Typeahead over artist names
+vector<SearchHit> RecommendationEngine::suggestArtists(const string& query, size_t limit) const {
+    return artist_search_->suggest(query, limit);
+}
+
+// Typeahead over song titles
+vector<SearchHit> RecommendationEngine::suggestSongs(const string& query, size_t limit) const {
+    return song_search_->suggest(query, limit);
+}
+
 // Train ML models with current data
-void RecommendationEngine::trainMLModels(const ArtistDatabase& artists, const SongDatabase& songs) {
+void RecommendationEngine::trainMLModels(const ArtistDatabase& artists, const SongDatabase& songs,
+                                         const ClusterAssignments* saved) {
     if (!ml_enabled_) return;
     
-    // Convert maps to vectors for training
-    vector<Artist> artist_list;
-    vector<Song> song_list;
-    
-    for (const auto& [id, artist] : artists) {
-        artist_list.push_back(artist);
+    if (song_store_->rows() != songs.idBound()) {
+        song_store_.write().build(songs, artists);
     }
     
-    for (const auto& [id, song] : songs) {
-        song_list.push_back(song);
+    // Train models
+    if (!artists.empty()) {
+        ml_enhancer_.trainArtistModel(artists, &artist_stats_, saved);
     }
     
-    // Train models
-    if (!artist_list.empty()) {
-        ml_enhancer_.trainArtistModel(artist_list);
+    if (!songs.empty()) {
+        ml_enhancer_.trainSongModel(*song_store_, saved);
+    }
+}
+
+// The trained clustering, for persisting with the catalog
+ClusterAssignments RecommendationEngine::exportClusters(const ArtistDatabase& artists) const {
+    if (!ml_enabled_) return ClusterAssignments();
+    return ml_enhancer_.exportClusters(artists, *song_store_);
+}
+
+// Refresh the changed artists' index entries and fold them into the ML model
+void RecommendationEngine::updateArtists(const ArtistDatabase& artists, const SongDatabase& songs,
+                                         const vector<DenseId>& upserted_ids, const vector<DenseId>& deleted_ids,
+                                         uint64_t version) {
+    catalog_version_ = version;
+    vector<string> touched = touchedNames(*artist_names_, upserted_ids, deleted_ids);
+    artist_names_.write().update(artists, upserted_ids, deleted_ids);
+    TagBitsets& tags = artist_tags_.write();
+    if (!tags.update(artists, upserted_ids) || !tags.update(artists, deleted_ids)) {
+        tags.build(artists); // new tags: the vocabulary grows
     }
+    refreshArtistFeatures(artists, upserted_ids, deleted_ids);
+    patchSearch(artist_search_.write(), *artist_names_, artists, std::move(touched), upserted_ids);
+    vector<DenseId> changed(upserted_ids);
+    changed.insert(changed.end(), deleted_ids.begin(), deleted_ids.end());
+    TagIndex& tag_index = artist_tag_index_.write();
+    tag_index.update(artists, changed);
+    if (tag_index.patchesFull()) tag_index.build(artists);
+    ArtistSongIndex& artist_songs = artist_songs_.write();
+    artist_songs.update(artists, songs, upserted_ids, deleted_ids, {}, {}); // songs may have gained or lost their artist
+    if (artist_songs.patchesFull()) artist_songs.build(artists, songs);
     
-    if (!song_list.empty()) {
-        ml_enhancer_.trainSongModel(song_list);
+    if (!ml_enabled_ || !ml_enhancer_.isArtistModelTrained()) return;
+    ml_enhancer_.updateArtists(artists, upserted_ids, deleted_ids);
+}
+
+// Refresh the changed songs' index entries and store rows, then fold them into the ML model
+void RecommendationEngine::updateSongs(const SongDatabase& songs, const ArtistDatabase& artists,
+                                       const vector<DenseId>& upserted_ids, const vector<DenseId>& deleted_ids,
+                                       uint64_t version) {
+    catalog_version_ = version;
+    vector<string> touched = touchedNames(*song_names_, upserted_ids, deleted_ids);
+    song_names_.write().update(songs, upserted_ids, deleted_ids);
+    patchSearch(song_search_.write(), *song_names_, songs, std::move(touched), upserted_ids);
+    ArtistSongIndex& artist_songs = artist_songs_.write();
+    artist_songs.update(artists, songs, {}, {}, upserted_ids, deleted_ids);
+    if (artist_songs.patchesFull()) artist_songs.build(artists, songs);
+    SongStore& store = song_store_.write();
+    if (!store.update(songs, artists, upserted_ids, deleted_ids)) {
+        store.build(songs, artists); // a song outgrew the feature stride
     }
+    
+    if (!ml_enabled_ || !ml_enhancer_.isSongModelTrained()) return;
+    ml_enhancer_.updateSongs(*song_store_, upserted_ids, deleted_ids);
 }
 
 // Recommend similar artists
@@ -41,25 +359,31 @@ RecommendationList RecommendationEngine::recommendSimilarArtists(const string& a
     RecommendationList results;
     
     // Find the input artist
-    auto it = find_if(artists.begin(), artists.end(),
-        [&](const auto& pair) { return pair.second.name == artist_name; });
+    DenseId input_id = pickSeed(artist_names_->find(artist_name), artist_name, "artists");
     
-    if (it == artists.end()) {
+    if (input_id == kInvalidDenseId) {
         cout << "Artist not found: " << artist_name << endl;
         return results;
     }
     
-    const Artist& input_artist = it->second;
+    const Artist& input_artist = artists[input_id];
+    const ArtistFeatures& input_features = (*artist_features_)[input_id];
 
-    // Generate base recommendations
-    for (const auto& [id, artist] : artists) {
-        if (artist.name == artist_name) continue;
+    // Generate base recommendations: features are cached normalized once per
+    // catalog version, so the cosine is one fixed-size dot product per
+    // candidate, and the tag Jaccard an AND + popcount over the two tag rows
+    // (a merge of two short sorted arrays for large vocabularies)
+    for (auto candidate = artists.begin(); candidate != artists.end(); ++candidate) {
+        if (candidate.id() == input_id) continue;
+        const Artist& artist = *candidate;
         
-        double sim = similarity_calc_.calculateArtistSimilarity(input_artist, artist);
+        double feature_sim = similarity_calc_.calculateNormalizedSimilarity(input_features, (*artist_features_)[candidate.id()]);
+        double tag_sim = artist_tags_->jaccard(input_id, candidate.id());
+        double sim = (1.0 - tag_weight_) * feature_sim + tag_weight_ * tag_sim;
         double adj = popularity_adjuster_.adjustForPopularity(sim, artist.popularity_score);
         
         if (meetsPopularityCriteria(artist.popularity_score) && adj > similarity_threshold_) {
-            results.push_back({artist.name, "", sim, adj, "Similar artist"});
+            results.push_back({artist.name, "", sim, adj, "Similar artist", candidate.id()});
         }
     }
     
@@ -75,7 +399,7 @@ RecommendationList RecommendationEngine::recommendSimilarArtists(const string& a
     
     // Apply ML enhancement if enabled and trained
     if (ml_enabled_ && ml_enhancer_.isArtistModelTrained()) {
-        results = ml_enhancer_.enhanceArtistRecommendations(results, input_artist, artists);
+        results = ml_enhancer_.enhanceArtistRecommendations(results, input_artist);
     }
     
     return results;
@@ -84,30 +408,47 @@ RecommendationList RecommendationEngine::recommendSimilarArtists(const string& a
 // Recommend similar songs
 RecommendationList RecommendationEngine::recommendSimilarSongs(const string& song_title,
                                                               const SongDatabase& songs,
-                                                              const ArtistDatabase& artists,
                                                               int num_recommendations) {
     RecommendationList results;
     
     // Find the input song
-    auto it = find_if(songs.begin(), songs.end(),
-        [&](const auto& pair) { return pair.second.name == song_title; });
+    DenseId input_id = pickSeed(song_names_->find(song_title), song_title, "songs");
     
-    if (it == songs.end()) {
+    if (input_id == kInvalidDenseId) {
         cout << "Song not found: " << song_title << endl;
         return results;
     }
     
-    const Song& input_song = it->second;
+    // Records are only touched for the songs that made the cut
+    results = rankSimilarSongs(input_id, num_recommendations);
+    for (auto& result : results) result.song_title = songs[result.item_id].name;
+    
+    // Apply ML enhancement if enabled and trained
+    if (ml_enabled_ && ml_enhancer_.isSongModelTrained()) {
+        results = ml_enhancer_.enhanceSongRecommendations(results, *song_store_, input_id);
+    }
+    
+    return results;
+}
 
-    // Generate base recommendations
-    for (const auto& [id, song] : songs) {
-        if (song.name == song_title) continue;
+// Top similar songs to the seed row: one streamed pass over the song store
+// (batch kernel, at the store's precision), names left for the caller
+RecommendationList RecommendationEngine::rankSimilarSongs(DenseId input_id, int num_recommendations) {
+    RecommendationList results;
+    vector<float> query(song_store_->stride());
+    song_store_->copyFeatures(input_id, query.data());
+    vector<double> similarities;
+    similarity_calc_.calculateSongSimilarities(*song_store_, query.data(), similarities);
+    
+    for (DenseId row = 0; row < song_store_->rows(); ++row) {
+        if (!song_store_->isLive(row) || row == input_id) continue;
         
-        double sim = similarity_calc_.calculateSongSimilarity(input_song, song);
-        double adj = popularity_adjuster_.adjustForPopularity(sim, song.popularity_score);
+        double sim = similarities[row];
+        double popularity = song_store_->popularity(row);
+        double adj = popularity_adjuster_.adjustForPopularity(sim, popularity);
         
-        if (meetsPopularityCriteria(song.popularity_score) && adj > similarity_threshold_) {
-            results.push_back({"", song.name, sim, adj, "Similar song"});
+        if (meetsPopularityCriteria(popularity) && adj > similarity_threshold_) {
+            results.push_back({"", "", sim, adj, "Similar song", row});
         }
     }
     
@@ -121,14 +462,140 @@ RecommendationList RecommendationEngine::recommendSimilarSongs(const string& son
         results.resize(num_recommendations);
     }
     
+    return results;
+}
+
+// Artists sharing rare tags with the seed artist
+RecommendationList RecommendationEngine::recommendArtistsByRareTags(const string& artist_name,
+                                                                   const ArtistDatabase& artists,
+                                                                   int num_recommendations) {
+    RecommendationList results;
+    
+    DenseId input_id = pickSeed(artist_names_->find(artist_name), artist_name, "artists");
+    
+    if (input_id == kInvalidDenseId) {
+        cout << "Artist not found: " << artist_name << endl;
+        return results;
+    }
+    
+    // Top-k by tag score among artists that pass the popularity cut-off
+    vector<TagMatch> matches = artist_tag_index_->topK(input_id, max(num_recommendations, 0),
+        [&](DenseId id) { return meetsPopularityCriteria(artists[id].popularity_score); });
+    
+    for (const TagMatch& match : matches) {
+        const Artist& artist = artists[match.artist];
+        double adj = popularity_adjuster_.adjustForPopularity(match.score, artist.popularity_score);
+        
+        // Name the two rarest shared tags (both vectors are sorted by tag)
+        vector<Symbol> shared;
+        const TagPosting* a = artist_tag_index_->vectorBegin(input_id);
+        const TagPosting* b = artist_tag_index_->vectorBegin(match.artist);
+        while (a != artist_tag_index_->vectorEnd(input_id) && b != artist_tag_index_->vectorEnd(match.artist)) {
+            if (a->id < b->id) ++a;
+            else if (b->id < a->id) ++b;
+            else { shared.push_back(a->id); ++a; ++b; }
+        }
+        sort(shared.begin(), shared.end(), [&](Symbol x, Symbol y) {
+            return artist_tag_index_->idf(x) > artist_tag_index_->idf(y);
+        });
+        string reason = "Shares rare tags:";
+        for (size_t i = 0; i < shared.size() && i < 2; ++i) reason += (i ? ", " : " ") + symbolName(shared[i]);
+        
+        results.push_back({artist.name, "", match.score, adj, reason, match.artist});
+    }
+    
+    sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+        return a.adjusted_score > b.adjusted_score;
+    });
+    
+    return results;
+}
+
+// More songs by the seed song's artist
+RecommendationList RecommendationEngine::recommendMoreByArtist(const string& song_title,
+                                                              const SongDatabase& songs,
+                                                              const ArtistDatabase& artists,
+                                                              int num_recommendations) {
+    RecommendationList results;
+    
+    DenseId input_id = pickSeed(song_names_->find(song_title), song_title, "songs");
+    
+    if (input_id == kInvalidDenseId) {
+        cout << "Song not found: " << song_title << endl;
+        return results;
+    }
+    
+    DenseId artist_id = artists.find(songs[input_id].artist_id);
+    if (artist_id == kInvalidDenseId) {
+        cout << "No artist on record for: " << songs[input_id].name << endl;
+        return results;
+    }
+    
+    // Score only the artist's slice; no popularity cut-off, these are all the same artist
+    vector<float> query(song_store_->stride());
+    song_store_->copyFeatures(input_id, query.data());
+    const string& artist_name = artists[artist_id].name;
+    
+    for (DenseId row : artist_songs_->songsOf(artist_id)) {
+        if (row == input_id) continue;
+        
+        double sim = similarity_calc_.calculateSongSimilarity(*song_store_, query.data(), row);
+        double adj = popularity_adjuster_.adjustForPopularity(sim, song_store_->popularity(row));
+        results.push_back({artist_name, songs[row].name, sim, adj, "More by " + artist_name, row});
+    }
+    
+    // Sort by adjusted score
+    sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+        return a.adjusted_score > b.adjusted_score;
+    });
+    
+    // Limit results
+    if (results.size() > static_cast<size_t>(num_recommendations)) {
+        results.resize(num_recommendations);
+    }
+    
+    return results;
+}
+
+// Recommend similar songs, naming them from a columnar catalog
+RecommendationList RecommendationEngine::recommendSimilarSongs(const string& song_title,
+                                                              const ColumnarCatalog& catalog,
+                                                              int num_recommendations) {
+    RecommendationList results;
+    
+    if (catalog.size() != song_store_->rows()) {
+        cout << "Columnar catalog does not match the indexed songs" << endl;
+        return results;
+    }
+    
+    DenseId input_id = pickSeed(song_names_->find(song_title), song_title, "songs");
+    
+    if (input_id == kInvalidDenseId) {
+        cout << "Song not found: " << song_title << endl;
+        return results;
+    }
+    
+    // Scoring runs on the song store; only the surviving rows fault in the names column
+    results = rankSimilarSongs(input_id, num_recommendations);
+    for (auto& result : results) result.song_title = string(catalog.name(result.item_id));
+    
     // Apply ML enhancement if enabled and trained
     if (ml_enabled_ && ml_enhancer_.isSongModelTrained()) {
-        results = ml_enhancer_.enhanceSongRecommendations(results, input_song, songs);
+        results = ml_enhancer_.enhanceSongRecommendations(results, *song_store_, input_id);
     }
     
     return results;
 }
 
+// First of several same-named matches (lowest dense id), kInvalidDenseId for none
+DenseId RecommendationEngine::pickSeed(const vector<DenseId>& matches, const string& name, const string& kind) {
+    if (matches.empty()) return kInvalidDenseId;
+    if (matches.size() > 1) {
+        cout << matches.size() << " " << kind << " match \"" << name << "\"; using the first one" << endl;
+    }
+    return matches.front();
+}
+
 // Set similarity threshold
 void RecommendationEngine::setSimilarityThreshold(double threshold) {
     similarity_threshold_ = threshold;
@@ -139,11 +606,25 @@ void RecommendationEngine::setMaxPopularity(double max_popularity) {
     max_popularity_ = max_popularity;
 }
 
+// Set the tag Jaccard's share of the artist similarity
+void RecommendationEngine::setTagWeight(double weight) {
+    tag_weight_ = min(max(weight, 0.0), 1.0);
+}
+
 // Enable/disable ML enhancement
 void RecommendationEngine::enableML(bool enable) {
     ml_enabled_ = enable;
 }
 
+// Carry the parameters over to an engine built for a newer catalog version
+void RecommendationEngine::copySettings(const RecommendationEngine& other) {
+    similarity_threshold_ = other.similarity_threshold_;
+    max_popularity_ = other.max_popularity_;
+    tag_weight_ = other.tag_weight_;
+    ml_enabled_ = other.ml_enabled_;
+    song_store_.write().setPrecision(other.song_store_->precision());
+}
+
 // Check if popularity meets criteria
 bool RecommendationEngine::meetsPopularityCriteria(double popularity_score) {
     return popularity_score <= max_popularity_;
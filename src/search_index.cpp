@@ -0,0 +1,387 @@
+#include "search_index.h"
+#include "name_index.h"
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+using namespace std;
+
+void SearchIndex::build(const vector<pair<string_view, double>>& names) {
+    struct Pending {
+        string key;
+        string_view name;
+        double score;
+    };
+    vector<Pending> pending;
+    pending.reserve(names.size());
+    for (const auto& [name, score] : names) {
+        string key = NameIndex::normalize(name);
+        if (!key.empty()) pending.push_back({std::move(key), name, score});
+    }
+    stable_sort(pending.begin(), pending.end(),
+        [](const Pending& a, const Pending& b) { return a.key < b.key; });
+
+    keys_.clear();
+    names_.clear();
+    offsets_.assign(1, 0);
+    name_offsets_.assign(1, 0);
+    scores_.clear();
+    records_.clear();
+    trigram_counts_.clear();
+
+    // One entry per distinct normalized name; the first record names it, the best score ranks it
+    for (size_t i = 0; i < pending.size(); ++i) {
+        if (i > 0 && pending[i].key == pending[i - 1].key) {
+            scores_.back() = max(scores_.back(), static_cast<float>(pending[i].score));
+            ++records_.back();
+            continue;
+        }
+        keys_ += pending[i].key;
+        offsets_.push_back(keys_.size());
+        names_ += pending[i].name;
+        name_offsets_.push_back(names_.size());
+        scores_.push_back(static_cast<float>(pending[i].score));
+        records_.push_back(1);
+    }
+    pending.clear();
+    pending.shrink_to_fit();
+
+    const uint32_t entries = static_cast<uint32_t>(scores_.size());
+    patched_.clear();
+    masked_.clear();
+    overlay_.reset();
+
+    // Range-max table: level 0 holds each block's best entry, level k covers 2^k blocks
+    block_table_.clear();
+    const size_t blocks = (entries + kBlock - 1) / kBlock;
+    if (blocks > 0) {
+        block_table_.emplace_back(blocks);
+        for (size_t b = 0; b < blocks; ++b) {
+            uint32_t best = static_cast<uint32_t>(b * kBlock);
+            uint32_t end = static_cast<uint32_t>(min<size_t>(entries, (b + 1) * kBlock));
+            for (uint32_t e = best + 1; e < end; ++e) best = better(best, e);
+            block_table_[0][b] = best;
+        }
+        for (size_t width = 2; width <= blocks; width *= 2) {
+            const vector<uint32_t>& prev = block_table_.back();
+            vector<uint32_t> level(blocks - width + 1);
+            for (size_t b = 0; b < level.size(); ++b) level[b] = better(prev[b], prev[b + width / 2]);
+            block_table_.push_back(std::move(level));
+        }
+    }
+
+    // Trigram postings: count per trigram, lay the lists out in trigram order, then fill
+    unordered_map<uint32_t, uint64_t> counts;
+    trigram_counts_.resize(entries);
+    for (uint32_t e = 0; e < entries; ++e) {
+        vector<uint32_t> grams = trigramsOf(key(e));
+        trigram_counts_[e] = static_cast<uint16_t>(min<size_t>(grams.size(), UINT16_MAX));
+        for (uint32_t gram : grams) ++counts[gram];
+    }
+
+    trigrams_.clear();
+    trigrams_.reserve(counts.size());
+    for (const auto& entry : counts) trigrams_.push_back(entry.first);
+    sort(trigrams_.begin(), trigrams_.end());
+
+    posting_offsets_.assign(trigrams_.size() + 1, 0);
+    for (size_t t = 0; t < trigrams_.size(); ++t) {
+        uint64_t count = counts[trigrams_[t]];
+        posting_offsets_[t + 1] = posting_offsets_[t] + count;
+        counts[trigrams_[t]] = posting_offsets_[t]; // reused as the fill cursor
+    }
+
+    postings_.assign(posting_offsets_.back(), 0);
+    for (uint32_t e = 0; e < entries; ++e) {
+        for (uint32_t gram : trigramsOf(key(e))) postings_[counts[gram]++] = e;
+    }
+}
+
+bool SearchIndex::save(BlobWriter& out) const {
+    if (!patched_.empty() || overlay_) return false;
+    out.text(keys_);
+    out.array(offsets_);
+    out.text(names_);
+    out.array(name_offsets_);
+    out.array(scores_);
+    out.array(records_);
+    out.array(trigram_counts_);
+    out.value<uint64_t>(block_table_.size());
+    for (const auto& level : block_table_) out.array(level);
+    out.array(trigrams_);
+    out.array(posting_offsets_);
+    out.array(postings_);
+    return true;
+}
+
+bool SearchIndex::load(BlobReader& in) {
+    *this = SearchIndex();
+    in.text(keys_);
+    in.array(offsets_);
+    in.text(names_);
+    in.array(name_offsets_);
+    in.array(scores_);
+    in.array(records_);
+    in.array(trigram_counts_);
+    uint64_t levels = 0;
+    if (in.value(levels) && levels <= 64) block_table_.resize(levels);
+    else in.fail();
+    for (auto& level : block_table_) in.array(level);
+    in.array(trigrams_);
+    in.array(posting_offsets_);
+    in.array(postings_);
+
+    const size_t entries = scores_.size();
+    auto ascending = [](const vector<uint64_t>& offsets, size_t total) {
+        for (size_t i = 1; i < offsets.size(); ++i) {
+            if (offsets[i - 1] > offsets[i]) return false;
+        }
+        return !offsets.empty() && offsets.back() == total;
+    };
+    auto entriesOnly = [entries](const vector<uint32_t>& ids) {
+        return all_of(ids.begin(), ids.end(), [entries](uint32_t id) { return id < entries; });
+    };
+    bool ok = in.ok() && offsets_.size() == entries + 1 && name_offsets_.size() == entries + 1 &&
+              records_.size() == entries && trigram_counts_.size() == entries &&
+              posting_offsets_.size() == trigrams_.size() + 1 &&
+              ascending(offsets_, keys_.size()) && ascending(name_offsets_, names_.size()) &&
+              ascending(posting_offsets_, postings_.size()) && entriesOnly(postings_) &&
+              (block_table_.empty() ? entries == 0 : block_table_[0].size() == (entries + kBlock - 1) / kBlock);
+    const size_t blocks = (entries + kBlock - 1) / kBlock;
+    for (size_t k = 1; ok && k < block_table_.size(); ++k) {
+        ok = (size_t(1) << k) <= blocks && block_table_[k].size() == blocks - (size_t(1) << k) + 1;
+    }
+    for (const auto& level : block_table_) ok = ok && entriesOnly(level);
+    if (!ok) {
+        *this = SearchIndex();
+        return in.fail();
+    }
+    return true;
+}
+
+void SearchIndex::patch(const vector<string>& touched, const vector<pair<string_view, double>>& records) {
+    if (masked_.size() != size()) masked_.assign(size(), 0);
+
+    // The touched names lose their base entries and their previous patches
+    for (const string& name : touched) {
+        string key = NameIndex::normalize(name);
+        if (key.empty()) continue;
+        uint32_t entry = lowerBound(key);
+        if (entry < size() && this->key(entry) == key) masked_[entry] = 1;
+        patched_[std::move(key)].clear();
+    }
+    for (const auto& [name, score] : records) {
+        auto it = patched_.find(NameIndex::normalize(name));
+        if (it != patched_.end()) it->second.emplace_back(string(name), static_cast<float>(score));
+    }
+
+    // The overlay is small, so it is simply rebuilt over every patched record
+    vector<pair<string_view, double>> overlay_records;
+    for (const auto& entry : patched_) {
+        for (const auto& [name, score] : entry.second) overlay_records.emplace_back(name, score);
+    }
+    auto overlay = make_shared<SearchIndex>();
+    overlay->build(overlay_records);
+    overlay_ = std::move(overlay);
+}
+
+uint32_t SearchIndex::lowerBound(string_view key) const {
+    uint32_t lo = 0, hi = static_cast<uint32_t>(size());
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (this->key(mid) < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+vector<uint32_t> SearchIndex::trigramsOf(string_view key) {
+    // Padded like pg_trgm so word starts weigh more than word ends
+    string padded = "  ";
+    padded += key;
+    padded += ' ';
+
+    vector<uint32_t> grams;
+    grams.reserve(padded.size());
+    for (size_t i = 0; i + 3 <= padded.size(); ++i) {
+        grams.push_back(static_cast<uint32_t>(static_cast<uint8_t>(padded[i])) << 16 |
+                        static_cast<uint32_t>(static_cast<uint8_t>(padded[i + 1])) << 8 |
+                        static_cast<uint32_t>(static_cast<uint8_t>(padded[i + 2])));
+    }
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+uint32_t SearchIndex::bestInRange(uint32_t first, uint32_t last) const {
+    size_t first_block = first / kBlock;
+    size_t last_block = last / kBlock;
+
+    uint32_t best = first;
+    if (last_block - first_block <= 1) {
+        for (uint32_t e = first + 1; e <= last; ++e) best = better(best, e);
+        return best;
+    }
+
+    // Partial blocks at both ends, whole blocks in between from the sparse table
+    uint32_t head_end = static_cast<uint32_t>((first_block + 1) * kBlock);
+    for (uint32_t e = first + 1; e < head_end; ++e) best = better(best, e);
+    for (uint32_t e = static_cast<uint32_t>(last_block * kBlock); e <= last; ++e) best = better(best, e);
+
+    size_t begin = first_block + 1;
+    size_t count = last_block - begin;
+    size_t level = 63 - __builtin_clzll(count);
+    best = better(best, block_table_[level][begin]);
+    best = better(best, block_table_[level][last_block - (size_t(1) << level)]);
+    return best;
+}
+
+SearchHit SearchIndex::hit(uint32_t entry, double match) const {
+    SearchHit result;
+    result.name.assign(names_.data() + name_offsets_[entry], name_offsets_[entry + 1] - name_offsets_[entry]);
+    result.score = scores_[entry];
+    result.match = match;
+    result.records = records_[entry];
+    return result;
+}
+
+vector<SearchHit> SearchIndex::complete(string_view prefix, size_t limit) const {
+    vector<SearchHit> hits = completeBase(prefix, limit);
+    if (!overlay_) return hits;
+
+    // Patched names come from the overlay; both lists are best score first
+    for (auto& extra : overlay_->complete(prefix, limit)) hits.push_back(std::move(extra));
+    stable_sort(hits.begin(), hits.end(), [](const SearchHit& a, const SearchHit& b) { return a.score > b.score; });
+    if (hits.size() > limit) hits.resize(limit);
+    return hits;
+}
+
+vector<SearchHit> SearchIndex::completeBase(string_view prefix, size_t limit) const {
+    vector<SearchHit> hits;
+    const string normalized = NameIndex::normalize(prefix);
+    const string_view p = normalized;
+    if (empty() || limit == 0) return hits;
+
+    // Names with the prefix form one contiguous range of the sorted keys
+    uint32_t lo = lowerBound(p);
+    uint32_t first = lo;
+    uint32_t hi = static_cast<uint32_t>(size());
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (key(mid).substr(0, p.size()) == p) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == first) return hits;
+
+    // Top-k by repeatedly splitting the range around its best entry
+    struct Range {
+        float score;
+        uint32_t best, first, last;
+        bool operator<(const Range& other) const { return score < other.score; }
+    };
+    priority_queue<Range> ranges;
+    auto push = [&](uint32_t a, uint32_t b) {
+        if (a > b) return;
+        uint32_t best = bestInRange(a, b);
+        ranges.push({scores_[best], best, a, b});
+    };
+    push(first, lo - 1);
+
+    while (!ranges.empty() && hits.size() < limit) {
+        Range range = ranges.top();
+        ranges.pop();
+        if (!masked(range.best)) hits.push_back(hit(range.best, 1.0));
+        if (range.best > range.first) push(range.first, range.best - 1);
+        push(range.best + 1, range.last);
+    }
+    return hits;
+}
+
+vector<SearchHit> SearchIndex::fuzzy(string_view query, size_t limit, double min_similarity) const {
+    vector<SearchHit> hits = fuzzyBase(query, limit, min_similarity);
+    if (!overlay_) return hits;
+
+    for (auto& extra : overlay_->fuzzy(query, limit, min_similarity)) hits.push_back(std::move(extra));
+    stable_sort(hits.begin(), hits.end(), [](const SearchHit& a, const SearchHit& b) {
+        if (a.match != b.match) return a.match > b.match;
+        return a.score > b.score;
+    });
+    if (hits.size() > limit) hits.resize(limit);
+    return hits;
+}
+
+vector<SearchHit> SearchIndex::fuzzyBase(string_view query, size_t limit, double min_similarity) const {
+    vector<SearchHit> hits;
+    vector<uint32_t> grams = trigramsOf(NameIndex::normalize(query));
+    if (empty() || limit == 0 || grams.size() <= 1) return hits;
+
+    // Posting lists of the query's trigrams, rarest first
+    vector<pair<uint64_t, uint64_t>> lists;
+    for (uint32_t gram : grams) {
+        auto it = lower_bound(trigrams_.begin(), trigrams_.end(), gram);
+        if (it == trigrams_.end() || *it != gram) continue;
+        size_t t = it - trigrams_.begin();
+        lists.emplace_back(posting_offsets_[t], posting_offsets_[t + 1]);
+    }
+    sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) {
+        return a.second - a.first < b.second - b.first;
+    });
+
+    // Rare lists nominate candidates; lists that would push the pool past the cap
+    // are only probed for the candidates already found (postings are sorted)
+    unordered_map<uint32_t, uint32_t> shared;
+    shared.reserve(kMaxCandidates);
+    for (const auto& [begin, end] : lists) {
+        uint64_t length = end - begin;
+        if (shared.empty() || shared.size() + length <= kMaxCandidates) {
+            uint64_t stop = begin + min<uint64_t>(length, kMaxCandidates);
+            for (uint64_t i = begin; i < stop; ++i) ++shared[postings_[i]];
+        } else {
+            for (auto& [entry, count] : shared) {
+                if (binary_search(postings_.begin() + begin, postings_.begin() + end, entry)) ++count;
+            }
+        }
+    }
+
+    vector<pair<double, uint32_t>> ranked;
+    for (const auto& [entry, count] : shared) {
+        double similarity = 2.0 * count / (grams.size() + trigram_counts_[entry]);
+        if (similarity >= min_similarity && !masked(entry)) ranked.emplace_back(similarity, entry);
+    }
+    size_t keep = min(limit, ranked.size());
+    partial_sort(ranked.begin(), ranked.begin() + keep, ranked.end(), [&](const auto& a, const auto& b) {
+        if (a.first != b.first) return a.first > b.first;
+        return scores_[a.second] > scores_[b.second];
+    });
+
+    for (size_t i = 0; i < keep; ++i) hits.push_back(hit(ranked[i].second, ranked[i].first));
+    return hits;
+}
+
+vector<SearchHit> SearchIndex::suggest(string_view query, size_t limit) const {
+    vector<SearchHit> hits = complete(query, limit);
+    if (hits.size() >= limit) return hits;
+
+    for (auto& candidate : fuzzy(query, limit + hits.size())) {
+        if (hits.size() >= limit) break;
+        bool seen = any_of(hits.begin(), hits.end(),
+            [&](const SearchHit& existing) { return existing.name == candidate.name; });
+        if (!seen) hits.push_back(std::move(candidate));
+    }
+    return hits;
+}
+
+size_t SearchIndex::memoryBytes() const {
+    size_t bytes = keys_.capacity() + names_.capacity() +
+                   (offsets_.capacity() + name_offsets_.capacity() + posting_offsets_.capacity()) * sizeof(uint64_t) +
+                   scores_.capacity() * sizeof(float) + records_.capacity() * sizeof(uint32_t) +
+                   trigram_counts_.capacity() * sizeof(uint16_t) +
+                   (trigrams_.capacity() + postings_.capacity()) * sizeof(uint32_t);
+    for (const auto& level : block_table_) bytes += level.capacity() * sizeof(uint32_t);
+    bytes += masked_.capacity();
+    for (const auto& [key, records] : patched_) {
+        bytes += key.capacity();
+        for (const auto& record : records) bytes += record.first.capacity() + sizeof(record);
+    }
+    if (overlay_) bytes += overlay_->memoryBytes();
+    return bytes;
+}
@@ -1,8 +1,64 @@
 #include "similarity_calculator.h"
-#include "feature_extractor.h"
 #include <cmath>
 using namespace std;
 
+namespace {
+
+inline float widen(float value) { return value; }
+inline float widen(uint16_t value) { return fromBFloat16(value); }
+
+// Dot product of the query with one stored row, accumulated in float32. Width is
+// the row stride when it has a compiled instantiation, 0 for the runtime-length
+// fallback; Element is the store's float or bfloat16 element type. The batch
+// scan and the single-row score both go through here, so they agree exactly.
+template <size_t Width, typename Element>
+float rowDot(const Element* row, const float* query, size_t stride) {
+    float dot_product = 0.0f;
+    if constexpr (Width > 0) {
+        unroll<Width>([&](auto d) { dot_product += query[d] * widen(row[d]); });
+    } else {
+        for(size_t d = 0; d < stride; ++d) dot_product += query[d] * widen(row[d]);
+    }
+    return dot_product;
+}
+
+// Cosine of the query against every live row
+template <size_t Width, typename Element>
+void scoreRows(const SongStore& store, const Element* matrix, const float* query,
+               double query_magnitude, size_t stride, vector<double>& scores) {
+    const Element* row = matrix;
+    for(DenseId id = 0; id < store.rows(); ++id, row += stride) {
+        double row_magnitude = store.norm(id);
+        if(!store.isLive(id) || row_magnitude == 0) continue;
+        scores[id] = rowDot<Width>(row, query, stride) / (query_magnitude * row_magnitude);
+    }
+}
+
+template <typename Element>
+void scoreMatrix(const SongStore& store, const Element* matrix, const float* query,
+                 double query_magnitude, vector<double>& scores) {
+    const size_t stride = store.stride();
+    bool fixed = dispatchFeatureDims(stride, [&](auto width) {
+        scoreRows<width>(store, matrix, query, query_magnitude, stride, scores);
+    });
+    if(!fixed) scoreRows<0>(store, matrix, query, query_magnitude, stride, scores);
+}
+
+template <typename Element>
+float scoreRow(const Element* row, const float* query, size_t stride) {
+    float dot_product = 0.0f;
+    bool fixed = dispatchFeatureDims(stride, [&](auto width) { dot_product = rowDot<width>(row, query, stride); });
+    return fixed ? dot_product : rowDot<0>(row, query, stride);
+}
+
+double queryMagnitude(const float* query, size_t stride) {
+    double query_sum = 0.0;
+    for(size_t d = 0; d < stride; ++d) query_sum += static_cast<double>(query[d]) * query[d];
+    return sqrt(query_sum);
+}
+
+} // namespace
+
 double SimilarityCalculator::calculateCosineSimilarity(const vector<double>& vec1, const vector<double>& vec2) {
     double dot_product = dotProduct(vec1, vec2);
     double magnitude1 = magnitude(vec1);
@@ -24,17 +80,47 @@ double SimilarityCalculator::calculateEuclideanDistance(const vector<double>& ve
 }
 
 double SimilarityCalculator::calculateArtistSimilarity(const Artist& artist1, const Artist& artist2) {
-    FeatureExtractor fe;
-    vector<double> features1 = fe.extractArtistFeatures(artist1);
-    vector<double> features2 = fe.extractArtistFeatures(artist2);
+    return calculateArtistSimilarity(feature_extractor_.extractArtistFeatureVec(artist1), artist2);
+}
 
-    return calculateCosineSimilarity(features1, features2);
+double SimilarityCalculator::calculateArtistSimilarity(const ArtistFeatures& features1, const Artist& artist2) {
+    return calculateCosineSimilarity(features1, feature_extractor_.extractArtistFeatureVec(artist2));
 }
 
 double SimilarityCalculator::calculateSongSimilarity(const Song& song1, const Song& song2) {
     return calculateCosineSimilarity(song1.features, song2.features);
 }
 
+void SimilarityCalculator::calculateSongSimilarities(const SongStore& store, const float* query,
+                                                     vector<double>& scores) {
+    const size_t stride = store.stride();
+    scores.assign(store.rows(), 0.0);
+
+    double query_magnitude = queryMagnitude(query, stride);
+    if(query_magnitude == 0) return;
+
+    // Rows are contiguous, so this is one sequential pass over the matrix
+    if(store.precision() == FeaturePrecision::Float32) {
+        scoreMatrix(store, store.matrix(), query, query_magnitude, scores);
+    } else {
+        scoreMatrix(store, store.bf16Matrix(), query, query_magnitude, scores);
+    }
+}
+
+double SimilarityCalculator::calculateSongSimilarity(const SongStore& store, const float* query, DenseId row) {
+    double row_magnitude = store.isLive(row) ? store.norm(row) : 0.0;
+    if(row_magnitude == 0) return 0.0;
+
+    const size_t stride = store.stride();
+    double query_magnitude = queryMagnitude(query, stride);
+    if(query_magnitude == 0) return 0.0;
+
+    float dot_product = store.precision() == FeaturePrecision::Float32
+        ? scoreRow(store.matrix() + size_t(row) * stride, query, stride)
+        : scoreRow(store.bf16Matrix() + size_t(row) * stride, query, stride);
+    return dot_product / (query_magnitude * row_magnitude);
+}
+
 double SimilarityCalculator::distanceToSimilarity(double distance) {
     return 1.0 /(1.0+distance);
 }
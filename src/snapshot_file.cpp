@@ -0,0 +1,318 @@
+#include "snapshot_file.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+using namespace snapshot;
+
+namespace {
+
+uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+// Deduplicating string table builder (genres and tags repeat a lot)
+class StringTableBuilder {
+public:
+    bool add(const string& value, StringRef& ref) {
+        auto it = index_.find(value);
+        if (it != index_.end()) {
+            ref = it->second;
+            return true;
+        }
+        if (blob_.size() + value.size() > numeric_limits<uint32_t>::max()) return false;
+
+        ref = {static_cast<uint32_t>(blob_.size()), static_cast<uint32_t>(value.size())};
+        blob_ += value;
+        index_.emplace(value, ref);
+        return true;
+    }
+
+    const string& blob() const { return blob_; }
+
+private:
+    unordered_map<string, StringRef> index_;
+    string blob_;
+};
+
+// Packed ids are written as is; Other ids keep their text in the string table
+bool addId(StringTableBuilder& strings, const PackedId& id, IdRef& ref) {
+    ref = {id.high(), id.low()};
+    if (id.kind() != PackedId::Kind::Other) return true;
+
+    StringRef text;
+    if (!strings.add(id.str(), text)) return false;
+    ref.low = (uint64_t(text.offset) << 32) | text.length;
+    return true;
+}
+
+template <typename T>
+void writeSection(ofstream& out, const vector<T>& items, uint64_t offset) {
+    out.seekp(static_cast<streamoff>(offset));
+    out.write(reinterpret_cast<const char*>(items.data()), static_cast<streamsize>(items.size() * sizeof(T)));
+}
+
+} // namespace
+
+bool SnapshotFile::write(const string& filename, const ArtistDatabase& artists, const SongDatabase& songs,
+                         const ClusterAssignments* clusters, const string* indexes) {
+    StringTableBuilder strings;
+    vector<ArtistRecord> artist_records;
+    vector<SongRecord> song_records;
+    vector<uint32_t> tags;
+    vector<StringRef> symbols(SymbolTable::global().size());
+    vector<double> features;
+
+    artist_records.reserve(artists.size());
+    song_records.reserve(songs.size());
+
+    // The whole symbol table in Symbol order, so records can store Symbols as is
+    for (size_t symbol = 0; symbol < symbols.size(); ++symbol) {
+        if (!strings.add(symbolName(static_cast<Symbol>(symbol)), symbols[symbol])) {
+            cerr << "Snapshot string table exceeds 4 GiB" << endl;
+            return false;
+        }
+    }
+
+    for (const auto& artist : artists) {
+        ArtistRecord record = {};
+        bool ok = addId(strings, artist.id, record.id) &&
+                  strings.add(artist.name, record.name);
+        record.genre = artist.genre;
+        record.genre_code = static_cast<uint32_t>(artist.genre_code);
+        record.popularity_score = artist.popularity_score;
+        record.tags_begin = static_cast<uint32_t>(tags.size());
+        record.tags_count = static_cast<uint32_t>(artist.tags.size());
+        tags.insert(tags.end(), artist.tags.begin(), artist.tags.end());
+        if (!ok) {
+            cerr << "Snapshot string table exceeds 4 GiB" << endl;
+            return false;
+        }
+        artist_records.push_back(record);
+    }
+
+    for (const auto& song : songs) {
+        SongRecord record = {};
+        bool ok = addId(strings, song.id, record.id) &&
+                  strings.add(song.name, record.name) &&
+                  addId(strings, song.artist_id, record.artist_id);
+        if (!ok) {
+            cerr << "Snapshot string table exceeds 4 GiB" << endl;
+            return false;
+        }
+        record.popularity_score = song.popularity_score;
+        record.features_begin = features.size();
+        record.features_count = static_cast<uint32_t>(song.features.size());
+        features.insert(features.end(), song.features.begin(), song.features.end());
+        song_records.push_back(record);
+    }
+
+    Header header = {};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.header_size = sizeof(Header);
+    header.artist_count = artist_records.size();
+    header.song_count = song_records.size();
+    header.tag_count = tags.size();
+    header.symbol_count = symbols.size();
+    header.feature_count = features.size();
+    header.string_bytes = strings.blob().size();
+
+    header.features_offset = align8(sizeof(Header));
+    header.artists_offset = align8(header.features_offset + features.size() * sizeof(double));
+    header.songs_offset = align8(header.artists_offset + artist_records.size() * sizeof(ArtistRecord));
+    header.tags_offset = align8(header.songs_offset + song_records.size() * sizeof(SongRecord));
+
+    // Cluster sections only when they line up with the records written above
+    bool with_model = clusters && clusters->clusters > 0 &&
+                      clusters->artists.size() == artist_records.size() &&
+                      clusters->songs.size() == song_records.size();
+    vector<int32_t> no_clusters;
+    const vector<int32_t>& artist_clusters = with_model ? clusters->artists : no_clusters;
+    const vector<int32_t>& song_clusters = with_model ? clusters->songs : no_clusters;
+    header.model_clusters = with_model ? clusters->clusters : 0;
+    header.artist_clusters_offset = align8(header.tags_offset + tags.size() * sizeof(uint32_t));
+    header.song_clusters_offset = align8(header.artist_clusters_offset + artist_clusters.size() * sizeof(int32_t));
+    header.symbols_offset = align8(header.song_clusters_offset + song_clusters.size() * sizeof(int32_t));
+
+    // Indexes address records by dense id, which a load renumbers past tombstones
+    bool with_indexes = indexes && !indexes->empty() && artists.tombstones() == 0 && songs.tombstones() == 0;
+    header.index_bytes = with_indexes ? indexes->size() : 0;
+    header.index_offset = align8(header.symbols_offset + symbols.size() * sizeof(StringRef));
+    header.strings_offset = align8(header.index_offset + header.index_bytes);
+
+    // Write to a temporary file and rename so readers never map a half-written snapshot
+    string tmp_filename = filename + ".tmp";
+    {
+        ofstream out(tmp_filename, ios::binary | ios::trunc);
+        if (!out.is_open()) return false;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeSection(out, features, header.features_offset);
+        writeSection(out, artist_records, header.artists_offset);
+        writeSection(out, song_records, header.songs_offset);
+        writeSection(out, tags, header.tags_offset);
+        writeSection(out, artist_clusters, header.artist_clusters_offset);
+        writeSection(out, song_clusters, header.song_clusters_offset);
+        writeSection(out, symbols, header.symbols_offset);
+        if (with_indexes) {
+            out.seekp(static_cast<streamoff>(header.index_offset));
+            out.write(indexes->data(), static_cast<streamsize>(indexes->size()));
+        }
+        out.seekp(static_cast<streamoff>(header.strings_offset));
+        out.write(strings.blob().data(), static_cast<streamsize>(strings.blob().size()));
+
+        if (!out.good()) {
+            remove(tmp_filename.c_str());
+            return false;
+        }
+    }
+    return rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+bool SnapshotFile::open(const string& filename) {
+    header_ = nullptr;
+    if (!file_.open(filename)) return false;
+
+    if (file_.size() < sizeof(Header)) {
+        file_.close();
+        return false;
+    }
+
+    header_ = reinterpret_cast<const Header*>(file_.data());
+    if (!validateLayout()) {
+        cerr << "Invalid or incompatible snapshot: " << filename << endl;
+        header_ = nullptr;
+        file_.close();
+        return false;
+    }
+
+    const char* base = file_.data();
+    features_ = reinterpret_cast<const double*>(base + header_->features_offset);
+    artists_ = reinterpret_cast<const ArtistRecord*>(base + header_->artists_offset);
+    songs_ = reinterpret_cast<const SongRecord*>(base + header_->songs_offset);
+    tags_ = reinterpret_cast<const uint32_t*>(base + header_->tags_offset);
+    symbols_ = reinterpret_cast<const StringRef*>(base + header_->symbols_offset);
+    strings_ = base + header_->strings_offset;
+    return true;
+}
+
+bool SnapshotFile::validateLayout() const {
+    if (memcmp(header_->magic, kMagic, sizeof(kMagic)) != 0) return false;
+    if (header_->version != kVersion || header_->header_size != sizeof(Header)) return false;
+
+    // Every section must lie inside the file, in order
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t width) {
+        return offset % 8 == 0 && offset <= file_.size() &&
+               count <= (file_.size() - offset) / width;
+    };
+    return fits(header_->features_offset, header_->feature_count, sizeof(double)) &&
+           fits(header_->artists_offset, header_->artist_count, sizeof(ArtistRecord)) &&
+           fits(header_->songs_offset, header_->song_count, sizeof(SongRecord)) &&
+           fits(header_->tags_offset, header_->tag_count, sizeof(uint32_t)) &&
+           fits(header_->symbols_offset, header_->symbol_count, sizeof(StringRef)) &&
+           fits(header_->index_offset, header_->index_bytes, 1) &&
+           fits(header_->strings_offset, header_->string_bytes, 1) &&
+           (header_->model_clusters == 0 ||
+            (fits(header_->artist_clusters_offset, header_->artist_count, sizeof(int32_t)) &&
+             fits(header_->song_clusters_offset, header_->song_count, sizeof(int32_t))));
+}
+
+string_view SnapshotFile::str(const StringRef& ref) const {
+    if (uint64_t(ref.offset) + ref.length > header_->string_bytes) return string_view();
+    return string_view(strings_ + ref.offset, ref.length);
+}
+
+string_view SnapshotFile::symbol(uint32_t index) const {
+    return index < header_->symbol_count ? str(symbols_[index]) : string_view();
+}
+
+string_view SnapshotFile::indexes() const {
+    if (!header_ || header_->index_bytes == 0) return string_view();
+    return string_view(file_.data() + header_->index_offset, header_->index_bytes);
+}
+
+PackedId SnapshotFile::id(const IdRef& ref) const {
+    if (ref.high != PackedId::kOtherTag) return PackedId::fromWords(ref.high, ref.low);
+    StringRef text = {static_cast<uint32_t>(ref.low >> 32), static_cast<uint32_t>(ref.low)};
+    return PackedId::parse(str(text));
+}
+
+ArtistView SnapshotFile::artist(size_t index) const {
+    const ArtistRecord& record = artists_[index];
+    bool tags_in_range = uint64_t(record.tags_begin) + record.tags_count <= header_->tag_count;
+    GenreCode genre_code = record.genre_code <= static_cast<uint32_t>(GenreCode::Ambient)
+        ? static_cast<GenreCode>(record.genre_code) : encodeGenre(symbol(record.genre));
+    return {id(record.id), str(record.name), record.genre, genre_code, record.popularity_score,
+            tags_ + (tags_in_range ? record.tags_begin : 0), tags_in_range ? record.tags_count : 0};
+}
+
+SongView SnapshotFile::song(size_t index) const {
+    const SongRecord& record = songs_[index];
+    bool features_in_range = record.features_begin <= header_->feature_count &&
+                             record.features_count <= header_->feature_count - record.features_begin;
+    return {id(record.id), str(record.name), id(record.artist_id), record.popularity_score,
+            features_ + (features_in_range ? record.features_begin : 0),
+            features_in_range ? record.features_count : 0};
+}
+
+bool SnapshotFile::materialize(ArtistDatabase& artists, SongDatabase& songs) const {
+    artists.reserve(artists.size() + artistCount());
+    songs.reserve(songs.size() + songCount());
+
+    // Each symbol is interned once; in a fresh process they keep their numbers
+    vector<Symbol> symbols(symbolCount());
+    bool stable = true;
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        symbols[i] = internSymbol(symbol(static_cast<uint32_t>(i)));
+        stable = stable && symbols[i] == i;
+    }
+    auto resolve = [&](uint32_t index) {
+        if (index < symbols.size()) return symbols[index];
+        stable = false;
+        return kEmptySymbol;
+    };
+
+    // Records are written in dense id order, so a fresh catalog gets the same ids back
+    for (size_t i = 0; i < artistCount(); ++i) {
+        ArtistView view = artist(i);
+        Artist target;
+        target.id = view.id;
+        target.name = view.name;
+        target.genre = resolve(view.genre);
+        target.genre_code = view.genre_code;
+        target.popularity_score = view.popularity_score;
+        target.tags.reserve(view.tag_count);
+        for (size_t t = 0; t < view.tag_count; ++t) target.tags.push_back(resolve(view.tags[t]));
+        artists.insert_or_assign(std::move(target));
+    }
+
+    for (size_t i = 0; i < songCount(); ++i) {
+        SongView view = song(i);
+        Song target;
+        target.id = view.id;
+        target.name = view.name;
+        target.artist_id = view.artist_id;
+        target.popularity_score = view.popularity_score;
+        target.features.assign(view.features, view.features + view.feature_count);
+        songs.insert_or_assign(std::move(target));
+    }
+    return stable;
+}
+
+ClusterAssignments SnapshotFile::clusters() const {
+    ClusterAssignments result;
+    if (!header_ || header_->model_clusters == 0 ||
+        header_->model_clusters > numeric_limits<uint32_t>::max()) return result;
+
+    const char* base = file_.data();
+    const int32_t* artist_clusters = reinterpret_cast<const int32_t*>(base + header_->artist_clusters_offset);
+    const int32_t* song_clusters = reinterpret_cast<const int32_t*>(base + header_->song_clusters_offset);
+    result.clusters = static_cast<uint32_t>(header_->model_clusters);
+    result.artists.assign(artist_clusters, artist_clusters + artistCount());
+    result.songs.assign(song_clusters, song_clusters + songCount());
+    return result;
+}
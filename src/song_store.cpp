@@ -0,0 +1,194 @@
+#include "song_store.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+using namespace std;
+
+namespace {
+
+constexpr size_t kMaxDims = numeric_limits<uint8_t>::max();
+
+} // namespace
+
+const char* precisionName(FeaturePrecision precision) {
+    return precision == FeaturePrecision::Float32 ? "float32" : "bfloat16";
+}
+
+void SongStore::build(const SongDatabase& songs, const ArtistDatabase& artists) {
+    size_t dims = 0;
+    for (const auto& song : songs) dims = max(dims, song.features.size());
+    if (dims > kMaxDims) {
+        cerr << "Songs have up to " << dims << " features; the song store keeps the first " << kMaxDims << endl;
+        dims = kMaxDims;
+    }
+
+    clear();
+    precision_ = next_precision_;
+    if (precision_ == FeaturePrecision::Float32) {
+        BFloat16Vector().swap(bf16_features_); // release the matrix of the other precision
+    } else {
+        FloatVector().swap(features_);
+    }
+    stride_ = (dims + kStrideMultiple - 1) / kStrideMultiple * kStrideMultiple;
+    resizeRows(songs.idBound());
+
+    for (auto it = songs.begin(); it != songs.end(); ++it) {
+        setRow(it.id(), *it, artists);
+    }
+}
+
+void SongStore::save(BlobWriter& out) const {
+    out.value(precision_);
+    out.value<uint64_t>(stride_);
+    out.value<uint64_t>(live_count_);
+    out.array(features_);
+    out.array(bf16_features_);
+    out.array(popularity_);
+    out.array(norms_);
+    out.array(artists_);
+    out.array(dims_);
+    out.array(live_);
+}
+
+bool SongStore::load(BlobReader& in) {
+    FeaturePrecision precision;
+    uint64_t stride = 0, live_count = 0;
+    in.value(precision);
+    in.value(stride);
+    in.value(live_count);
+    in.array(features_);
+    in.array(bf16_features_);
+    in.array(popularity_);
+    in.array(norms_);
+    in.array(artists_);
+    in.array(dims_);
+    in.array(live_);
+
+    const size_t rows = popularity_.size();
+    const size_t matrix = precision == FeaturePrecision::Float32 ? features_.size() : bf16_features_.size();
+    bool ok = in.ok() && stride % kStrideMultiple == 0 && matrix == rows * stride &&
+              norms_.size() == rows && artists_.size() == rows && dims_.size() == rows && live_.size() == rows;
+    if (!ok) in.fail();
+    if (!ok || precision != next_precision_) {
+        clear();
+        return false;
+    }
+    precision_ = precision;
+    stride_ = stride;
+    live_count_ = live_count;
+    return true;
+}
+
+bool SongStore::update(const SongDatabase& songs, const ArtistDatabase& artists,
+                       const vector<DenseId>& upserted, const vector<DenseId>& deleted) {
+    for (DenseId id : upserted) {
+        if (songs.contains(id) && songs[id].features.size() > stride_) return false;
+    }
+
+    if (songs.idBound() > rows()) resizeRows(songs.idBound());
+    for (DenseId id : upserted) {
+        if (songs.contains(id)) setRow(id, songs[id], artists);
+    }
+    for (DenseId id : deleted) {
+        if (!songs.contains(id)) clearRow(id);
+    }
+    return true;
+}
+
+void SongStore::clear() {
+    stride_ = 0;
+    live_count_ = 0;
+    features_.clear();
+    bf16_features_.clear();
+    popularity_.clear();
+    norms_.clear();
+    artists_.clear();
+    dims_.clear();
+    live_.clear();
+}
+
+void SongStore::resizeRows(size_t rows) {
+    if (precision_ == FeaturePrecision::Float32) {
+        features_.resize(rows * stride_, 0.0f);
+    } else {
+        bf16_features_.resize(rows * stride_, 0);
+    }
+    popularity_.resize(rows, 0.0);
+    norms_.resize(rows, 0.0f);
+    artists_.resize(rows, kInvalidDenseId);
+    dims_.resize(rows, 0);
+    live_.resize(rows, 0);
+}
+
+void SongStore::setRow(DenseId row, const Song& song, const ArtistDatabase& artists) {
+    size_t dims = min(song.features.size(), stride_);
+    double sum = 0.0;
+    if (precision_ == FeaturePrecision::Float32) {
+        float* out = features_.data() + row * stride_;
+        for (size_t d = 0; d < dims; ++d) {
+            out[d] = static_cast<float>(song.features[d]);
+            sum += static_cast<double>(out[d]) * out[d];
+        }
+        fill(out + dims, out + stride_, 0.0f);
+    } else {
+        uint16_t* out = bf16_features_.data() + row * stride_;
+        for (size_t d = 0; d < dims; ++d) {
+            out[d] = toBFloat16(static_cast<float>(song.features[d]));
+            double value = fromBFloat16(out[d]);
+            sum += value * value;
+        }
+        fill(out + dims, out + stride_, 0);
+    }
+
+    popularity_[row] = song.popularity_score;
+    norms_[row] = static_cast<float>(sqrt(sum));
+    artists_[row] = artists.find(song.artist_id);
+    dims_[row] = static_cast<uint8_t>(dims);
+    if (!live_[row]) ++live_count_;
+    live_[row] = 1;
+}
+
+void SongStore::clearRow(DenseId row) {
+    if (row >= rows()) return;
+    if (precision_ == FeaturePrecision::Float32) {
+        fill(features_.begin() + row * stride_, features_.begin() + (row + 1) * stride_, 0.0f);
+    } else {
+        fill(bf16_features_.begin() + row * stride_, bf16_features_.begin() + (row + 1) * stride_, 0);
+    }
+    popularity_[row] = 0.0;
+    norms_[row] = 0.0f;
+    artists_[row] = kInvalidDenseId;
+    dims_[row] = 0;
+    if (live_[row]) --live_count_;
+    live_[row] = 0;
+}
+
+void SongStore::copyFeatures(DenseId row, float* out) const {
+    if (precision_ == FeaturePrecision::Float32) {
+        copy(features_.begin() + row * stride_, features_.begin() + (row + 1) * stride_, out);
+    } else {
+        const uint16_t* in = bf16_features_.data() + row * stride_;
+        for (size_t d = 0; d < stride_; ++d) out[d] = fromBFloat16(in[d]);
+    }
+}
+
+double SongStore::bytesPerSong() const {
+    if (rows() == 0) return 0.0;
+    size_t bytes = features_.capacity() * sizeof(float) + bf16_features_.capacity() * sizeof(uint16_t) +
+                   popularity_.capacity() * sizeof(double) +
+                   norms_.capacity() * sizeof(float) + artists_.capacity() * sizeof(DenseId) +
+                   dims_.capacity() + live_.capacity();
+    return static_cast<double>(bytes) / rows();
+}
+
+double SongStore::recordBytesPerSong(const SongDatabase& songs) {
+    if (songs.empty()) return 0.0;
+    size_t bytes = 0;
+    for (const auto& song : songs) {
+        bytes += sizeof(song.features) + song.features.capacity() * sizeof(double) +
+                 sizeof(song.popularity_score) + sizeof(song.artist_id);
+    }
+    return static_cast<double>(bytes) / songs.size();
+}
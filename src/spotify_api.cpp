@@ -125,19 +125,20 @@ Artist SpotifyAPI::searchArtist(const string& artist_name) {
 Artist SpotifyAPI::parseArtistFromJSON(const json& artist_data) {
     Artist artist;
     
-    artist.id = artist_data.value("id", "");
+    artist.id = PackedId::parse(artist_data.value("id", ""));
     artist.name = artist_data.value("name", "");
     artist.popularity_score = artist_data.value("popularity", 0) / 100.0; // Convert to 0-1 scale
     
     // Get genres
     if (artist_data.contains("genres") && artist_data["genres"].is_array()) {
         for (const auto& genre : artist_data["genres"]) {
-            artist.tags.push_back(genre.get<string>());
+            artist.tags.push_back(internSymbol(genre.get<string>()));
         }
     }
     
     // Set primary genre (first one or "Unknown")
-    artist.genre = artist.tags.empty() ? "Unknown" : artist.tags[0];
+    artist.genre = artist.tags.empty() ? internSymbol("Unknown") : artist.tags[0];
+    artist.genre_code = encodeGenre(symbolName(artist.genre));
     
     return artist;
 }
@@ -167,9 +168,9 @@ vector<Song> SpotifyAPI::getArtistTopTracks(const string& artist_id) {
 Song SpotifyAPI::parseSongFromJSON(const json& track_data, const string& artist_id) {
     Song song;
     
-    song.id = track_data.value("id", "");
+    song.id = PackedId::parse(track_data.value("id", ""));
     song.name = track_data.value("name", "");
-    song.artist_id = artist_id;
+    song.artist_id = PackedId::parse(artist_id);
     song.popularity_score = track_data.value("popularity", 0) / 100.0; // Convert to 0-1 scale
     
     // Initialize features vector (will be populated later)
@@ -246,7 +247,7 @@ vector<Artist> SpotifyAPI::loadMultipleArtists(const vector<string>& artist_name
 void SpotifyAPI::populateAudioFeatures(vector<Song>& songs) {
     for (auto& song : songs) {
         if (!song.id.empty()) {
-            song.features = getAudioFeatures(song.id);
+            song.features = getAudioFeatures(song.id.str());
         }
         // Add delay to respect rate limits
         this_thread::sleep_for(chrono::milliseconds(100));
@@ -0,0 +1,124 @@
+#include "symbol_table.h"
+#include <mutex>
+using namespace std;
+
+namespace {
+
+// Heap footprint of a std::string holding `length` characters
+size_t stringFootprint(size_t length) {
+    const size_t sso_capacity = 15; // libstdc++ / libc++ short string buffer
+    return sizeof(string) + (length > sso_capacity ? length + 1 : 0);
+}
+
+// Innermost LocalBatch of this thread (any table)
+thread_local SymbolTable::LocalBatch* current_batch = nullptr;
+
+} // namespace
+
+SymbolTable& SymbolTable::global() {
+    static SymbolTable table;
+    return table;
+}
+
+SymbolTable::SymbolTable() {
+    strings_.emplace_back();
+    index_.emplace(string_view(strings_.back()), kEmptySymbol);
+}
+
+Symbol SymbolTable::intern(string_view text) {
+    LocalBatch* batch = current_batch;
+    if (batch && &batch->table_ == this) {
+        ++batch->lookups_;
+        batch->raw_bytes_ += stringFootprint(text.size());
+        auto cached = batch->cache_.find(text);
+        if (cached != batch->cache_.end()) {
+            ++batch->hits_;
+            return cached->second;
+        }
+
+        bool existed;
+        const string* stored;
+        Symbol symbol = internShared(text, existed, stored);
+        if (existed) ++batch->hits_;
+        batch->cache_.emplace(string_view(*stored), symbol);
+        return symbol;
+    }
+
+    lookups_.fetch_add(1, memory_order_relaxed);
+    raw_bytes_.fetch_add(stringFootprint(text.size()), memory_order_relaxed);
+    bool existed;
+    const string* stored;
+    Symbol symbol = internShared(text, existed, stored);
+    if (existed) hits_.fetch_add(1, memory_order_relaxed);
+    return symbol;
+}
+
+Symbol SymbolTable::internShared(string_view text, bool& existed, const string*& stored) {
+    existed = true;
+
+    // Fast path: most values are already interned
+    {
+        shared_lock<shared_mutex> lock(mutex_);
+        auto it = index_.find(text);
+        if (it != index_.end()) {
+            stored = &strings_[it->second];
+            return it->second;
+        }
+    }
+
+    unique_lock<shared_mutex> lock(mutex_);
+    auto it = index_.find(text); // another thread may have added it meanwhile
+    if (it != index_.end()) {
+        stored = &strings_[it->second];
+        return it->second;
+    }
+
+    existed = false;
+    Symbol symbol = static_cast<Symbol>(strings_.size());
+    strings_.emplace_back(text);
+    stored = &strings_.back();
+    index_.emplace(string_view(strings_.back()), symbol);
+    pool_bytes_ += stringFootprint(text.size()) + sizeof(Symbol) + sizeof(string_view);
+    return symbol;
+}
+
+SymbolTable::LocalBatch::LocalBatch(SymbolTable& table) : table_(table), previous_(current_batch) {
+    current_batch = this;
+}
+
+SymbolTable::LocalBatch::~LocalBatch() {
+    table_.lookups_.fetch_add(lookups_, memory_order_relaxed);
+    table_.hits_.fetch_add(hits_, memory_order_relaxed);
+    table_.raw_bytes_.fetch_add(raw_bytes_, memory_order_relaxed);
+    current_batch = previous_;
+}
+
+bool SymbolTable::find(string_view text, Symbol& symbol) const {
+    shared_lock<shared_mutex> lock(mutex_);
+    auto it = index_.find(text);
+    if (it == index_.end()) return false;
+    symbol = it->second;
+    return true;
+}
+
+const string& SymbolTable::str(Symbol symbol) const {
+    static const string empty;
+    shared_lock<shared_mutex> lock(mutex_);
+    return symbol < strings_.size() ? strings_[symbol] : empty;
+}
+
+size_t SymbolTable::size() const {
+    shared_lock<shared_mutex> lock(mutex_);
+    return strings_.size();
+}
+
+InternStats SymbolTable::getStats() const {
+    shared_lock<shared_mutex> lock(mutex_);
+    InternStats stats;
+    stats.lookups = lookups_.load(memory_order_relaxed);
+    stats.hits = hits_.load(memory_order_relaxed);
+    stats.distinct = strings_.size();
+    stats.raw_bytes = raw_bytes_.load(memory_order_relaxed);
+    stats.pool_bytes = pool_bytes_;
+    return stats;
+}
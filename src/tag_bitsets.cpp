@@ -0,0 +1,210 @@
+#include "tag_bitsets.h"
+#include <algorithm>
+using namespace std;
+
+void TagBitsets::build(const ArtistDatabase& artists) {
+    // Vocabulary: every tag in use, numbered in order of first appearance.
+    // Symbols are dense, so the lookup is a plain array.
+    bit_of_.assign(SymbolTable::global().size(), kNoBit);
+    vocabulary_size_ = 0;
+    for (const Artist& artist : artists) {
+        for (Symbol tag : artist.tags) {
+            if (bit_of_[tag] == kNoBit) bit_of_[tag] = static_cast<uint32_t>(vocabulary_size_++);
+        }
+    }
+
+    sparse_ = vocabulary_size_ > kMaxDenseVocabulary;
+    counts_.assign(artists.idBound(), 0);
+    bits_.clear();
+    pool_.clear();
+    pool_begin_.clear();
+    stale_ = 0;
+
+    if (sparse_) {
+        words_ = 0;
+        pool_begin_.assign(artists.idBound(), 0);
+        vector<uint32_t> encoded;
+        for (auto it = artists.begin(); it != artists.end(); ++it) {
+            encodeSparse(*it, encoded);
+            pool_begin_[it.id()] = pool_.size();
+            counts_[it.id()] = static_cast<uint32_t>(encoded.size());
+            pool_.insert(pool_.end(), encoded.begin(), encoded.end());
+        }
+        return;
+    }
+
+    words_ = max<size_t>(1, (vocabulary_size_ + 63) / 64);
+    bits_.assign(artists.idBound() * words_, 0);
+    for (auto it = artists.begin(); it != artists.end(); ++it) {
+        uint64_t* bits = bits_.data() + static_cast<size_t>(it.id()) * words_;
+        encode(*it, bits);
+        size_t count = 0;
+        for (size_t w = 0; w < words_; ++w) count += __builtin_popcountll(bits[w]);
+        counts_[it.id()] = static_cast<uint32_t>(count);
+    }
+}
+
+bool TagBitsets::update(const ArtistDatabase& artists, const vector<DenseId>& changed_ids) {
+    if (sparse_) {
+        if (artists.idBound() > counts_.size()) {
+            counts_.resize(artists.idBound(), 0);
+            pool_begin_.resize(artists.idBound(), 0);
+        }
+        vector<uint32_t> encoded;
+        for (DenseId id : changed_ids) {
+            stale_ += counts_[id];
+            encoded.clear();
+            if (artists.contains(id)) encodeSparse(artists[id], encoded);
+            pool_begin_[id] = pool_.size();
+            counts_[id] = static_cast<uint32_t>(encoded.size());
+            pool_.insert(pool_.end(), encoded.begin(), encoded.end());
+        }
+        if (stale_ * 2 > pool_.size()) compactPool();
+        return true;
+    }
+
+    vector<uint64_t> encoded(words_ * changed_ids.size(), 0);
+    for (size_t i = 0; i < changed_ids.size(); ++i) {
+        DenseId id = changed_ids[i];
+        if (artists.contains(id) && !encode(artists[id], encoded.data() + i * words_)) return false;
+    }
+
+    if (artists.idBound() > counts_.size()) {
+        bits_.resize(artists.idBound() * words_, 0);
+        counts_.resize(artists.idBound(), 0);
+    }
+    for (size_t i = 0; i < changed_ids.size(); ++i) {
+        const uint64_t* source = encoded.data() + i * words_;
+        copy(source, source + words_, bits_.begin() + static_cast<size_t>(changed_ids[i]) * words_);
+        size_t count = 0;
+        for (size_t w = 0; w < words_; ++w) count += __builtin_popcountll(source[w]);
+        counts_[changed_ids[i]] = static_cast<uint32_t>(count);
+    }
+    return true;
+}
+
+void TagBitsets::clear() {
+    bit_of_.clear();
+    vocabulary_size_ = 0;
+    sparse_ = false;
+    words_ = 0;
+    bits_.clear();
+    counts_.clear();
+    pool_.clear();
+    pool_begin_.clear();
+    stale_ = 0;
+}
+
+void TagBitsets::save(BlobWriter& out) const {
+    out.value<uint64_t>(vocabulary_size_);
+    out.value<uint8_t>(sparse_);
+    out.value<uint64_t>(words_);
+    out.value<uint64_t>(stale_);
+    out.array(bit_of_);
+    out.array(bits_);
+    out.array(counts_);
+    out.array(pool_);
+    out.array(pool_begin_);
+}
+
+bool TagBitsets::load(BlobReader& in) {
+    clear();
+    uint64_t vocabulary = 0, words = 0, stale = 0;
+    uint8_t sparse = 0;
+    in.value(vocabulary);
+    in.value(sparse);
+    in.value(words);
+    in.value(stale);
+    in.array(bit_of_);
+    in.array(bits_);
+    in.array(counts_);
+    in.array(pool_);
+    in.array(pool_begin_);
+
+    const size_t rows = counts_.size();
+    bool ok = in.ok() && (sparse ? pool_begin_.size() == rows && bits_.empty()
+                                 : words == max<size_t>(1, (vocabulary + 63) / 64) && bits_.size() == rows * words);
+    for (size_t id = 0; ok && sparse && id < rows; ++id) {
+        ok = pool_begin_[id] <= pool_.size() && counts_[id] <= pool_.size() - pool_begin_[id];
+    }
+    if (!ok) {
+        clear();
+        return in.fail();
+    }
+    vocabulary_size_ = vocabulary;
+    sparse_ = sparse != 0;
+    words_ = words;
+    stale_ = stale;
+    return true;
+}
+
+bool TagBitsets::encode(const Artist& artist, uint64_t* row) const {
+    for (Symbol tag : artist.tags) {
+        uint32_t bit = tag < bit_of_.size() ? bit_of_[tag] : kNoBit;
+        if (bit == kNoBit) return false;
+        row[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+    return true;
+}
+
+// Sorted distinct vocabulary numbers of the artist's tags; new tags join the vocabulary
+void TagBitsets::encodeSparse(const Artist& artist, vector<uint32_t>& out) {
+    out.clear();
+    for (Symbol tag : artist.tags) {
+        if (tag >= bit_of_.size()) bit_of_.resize(SymbolTable::global().size(), kNoBit);
+        if (bit_of_[tag] == kNoBit) bit_of_[tag] = static_cast<uint32_t>(vocabulary_size_++);
+        out.push_back(bit_of_[tag]);
+    }
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+}
+
+// Rewrite the pool in dense id order, dropping rows replaced by updates
+void TagBitsets::compactPool() {
+    vector<uint32_t> pool;
+    pool.reserve(pool_.size() - stale_);
+    for (size_t id = 0; id < counts_.size(); ++id) {
+        size_t begin = pool_begin_[id];
+        pool_begin_[id] = pool.size();
+        pool.insert(pool.end(), pool_.begin() + begin, pool_.begin() + begin + counts_[id]);
+    }
+    pool_ = std::move(pool);
+    stale_ = 0;
+}
+
+size_t TagBitsets::intersection(DenseId a, DenseId b) const {
+    if (a >= counts_.size() || b >= counts_.size()) return 0;
+    size_t shared = 0;
+    if (sparse_) {
+        const uint32_t* tags_a = tags(a);
+        const uint32_t* tags_b = tags(b);
+        const uint32_t* end_a = tags_a + counts_[a];
+        const uint32_t* end_b = tags_b + counts_[b];
+        while (tags_a != end_a && tags_b != end_b) {
+            if (*tags_a < *tags_b) ++tags_a;
+            else if (*tags_b < *tags_a) ++tags_b;
+            else {
+                ++shared;
+                ++tags_a;
+                ++tags_b;
+            }
+        }
+        return shared;
+    }
+
+    const uint64_t* row_a = row(a);
+    const uint64_t* row_b = row(b);
+    for (size_t w = 0; w < words_; ++w) shared += __builtin_popcountll(row_a[w] & row_b[w]);
+    return shared;
+}
+
+double TagBitsets::jaccard(DenseId a, DenseId b) const {
+    size_t shared = intersection(a, b);
+    size_t either = count(a) + count(b) - shared;
+    return either > 0 ? static_cast<double>(shared) / either : 0.0;
+}
+
+double TagBitsets::overlap(DenseId a, DenseId b) const {
+    size_t smaller = min(count(a), count(b));
+    return smaller > 0 ? static_cast<double>(intersection(a, b)) / smaller : 0.0;
+}
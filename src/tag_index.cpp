@@ -0,0 +1,337 @@
+#include "tag_index.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+using namespace std;
+
+void TagIndex::build(const ArtistDatabase& artists) {
+    const size_t symbols = SymbolTable::global().size();
+    const size_t bound = artists.idBound();
+    artist_bound_ = bound;
+    patched_vectors_.clear();
+    patched_postings_.clear();
+    stale_.clear();
+
+    // Document frequencies (an artist counts once per distinct tag)
+    df_.assign(symbols, 0);
+    live_.assign(bound, 0);
+    for (auto it = artists.begin(); it != artists.end(); ++it) {
+        for (Symbol tag : distinctTags(*it)) ++df_[tag];
+        live_[it.id()] = 1;
+    }
+    live_artists_ = artists.size();
+    idf_.assign(symbols, 0.0);
+    for (size_t tag = 0; tag < symbols; ++tag) {
+        if (df_[tag] > 0) idf_[tag] = log(1.0 + static_cast<double>(live_artists_) / df_[tag]);
+    }
+
+    // Unit-length artist vectors, one sorted run per artist
+    vector_offsets_.assign(bound + 1, 0);
+    vectors_.clear();
+    for (DenseId id = 0; id < bound; ++id) {
+        vector_offsets_[id] = vectors_.size();
+        if (artists.contains(id)) weigh(artists[id], vectors_);
+    }
+    vector_offsets_[bound] = vectors_.size();
+
+    // Inverted index by counting sort: posting lists come out in artist id order
+    posting_offsets_.assign(symbols + 1, 0);
+    for (const TagPosting& entry : vectors_) ++posting_offsets_[entry.id + 1];
+    for (size_t tag = 1; tag <= symbols; ++tag) posting_offsets_[tag] += posting_offsets_[tag - 1];
+    postings_.resize(vectors_.size());
+    max_weight_.assign(symbols, 0.0f);
+    vector<size_t> cursor(posting_offsets_.begin(), posting_offsets_.end() - 1);
+    for (DenseId id = 0; id < bound; ++id) {
+        for (const TagPosting* entry = vectorBegin(id); entry != vectorEnd(id); ++entry) {
+            postings_[cursor[entry->id]++] = {id, entry->weight};
+            max_weight_[entry->id] = max(max_weight_[entry->id], entry->weight);
+        }
+    }
+}
+
+bool TagIndex::save(BlobWriter& out) const {
+    if (!patched_vectors_.empty() || !patched_postings_.empty()) return false;
+    out.value<uint64_t>(artist_bound_);
+    out.value<uint64_t>(live_artists_);
+    out.array(vector_offsets_);
+    out.array(vectors_);
+    out.array(posting_offsets_);
+    out.array(postings_);
+    out.array(max_weight_);
+    out.array(idf_);
+    out.array(df_);
+    out.array(live_);
+    return true;
+}
+
+bool TagIndex::load(BlobReader& in) {
+    clear();
+    uint64_t artist_bound = 0, live_artists = 0;
+    in.value(artist_bound);
+    in.value(live_artists);
+    in.array(vector_offsets_);
+    in.array(vectors_);
+    in.array(posting_offsets_);
+    in.array(postings_);
+    in.array(max_weight_);
+    in.array(idf_);
+    in.array(df_);
+    in.array(live_);
+
+    const size_t symbols = idf_.size();
+    auto ascending = [](const vector<size_t>& offsets, size_t total) {
+        for (size_t i = 1; i < offsets.size(); ++i) {
+            if (offsets[i - 1] > offsets[i]) return false;
+        }
+        return !offsets.empty() && offsets.back() == total;
+    };
+    bool ok = in.ok() && vector_offsets_.size() == artist_bound + 1 && posting_offsets_.size() == symbols + 1 &&
+              max_weight_.size() == symbols && df_.size() == symbols && live_.size() == artist_bound &&
+              ascending(vector_offsets_, vectors_.size()) && ascending(posting_offsets_, postings_.size());
+    for (size_t i = 0; ok && i < vectors_.size(); ++i) ok = vectors_[i].id < symbols;
+    for (size_t i = 0; ok && i < postings_.size(); ++i) ok = postings_[i].id < artist_bound;
+    if (!ok) {
+        clear();
+        return in.fail();
+    }
+    artist_bound_ = artist_bound;
+    live_artists_ = live_artists;
+    return true;
+}
+
+void TagIndex::update(const ArtistDatabase& artists, const vector<DenseId>& changed) {
+    // New tags get empty base lists; new artists have no base vector
+    const size_t symbols = SymbolTable::global().size();
+    if (posting_offsets_.empty()) posting_offsets_.assign(1, 0);
+    posting_offsets_.resize(symbols + 1, posting_offsets_.back());
+    max_weight_.resize(symbols, 0.0f);
+    idf_.resize(symbols, 0.0);
+    df_.resize(symbols, 0);
+    artist_bound_ = max<size_t>(artist_bound_, artists.idBound());
+    stale_.resize(artist_bound_, 0);
+    live_.resize(artist_bound_, 0);
+
+    vector<DenseId> ids(changed);
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+    // Take the old vectors out of the counts and the side lists
+    vector<Symbol> touched;
+    for (DenseId id : ids) {
+        const TagPosting* first = vectorBegin(id);
+        const TagPosting* last = vectorEnd(id);
+        for (const TagPosting* term = first; term != last; ++term) {
+            --df_[term->id];
+            touched.push_back(term->id);
+            if (stale(id)) {
+                vector<TagPosting>& list = patched_postings_[term->id].postings;
+                auto pos = lower_bound(list.begin(), list.end(), id,
+                    [](const TagPosting& posting, DenseId artist) { return posting.id < artist; });
+                if (pos != list.end() && pos->id == id) list.erase(pos);
+            }
+        }
+        if (live_[id]) --live_artists_;
+        stale_[id] = 1;
+        patched_vectors_[id].clear();
+        live_[id] = artists.contains(id);
+        if (live_[id]) {
+            for (Symbol tag : distinctTags(artists[id])) {
+                ++df_[tag];
+                touched.push_back(tag);
+            }
+            ++live_artists_;
+        }
+    }
+
+    sort(touched.begin(), touched.end());
+    touched.erase(unique(touched.begin(), touched.end()), touched.end());
+    for (Symbol tag : touched) {
+        idf_[tag] = df_[tag] > 0 ? log(1.0 + static_cast<double>(live_artists_) / df_[tag]) : 0.0;
+    }
+
+    // Weigh the new vectors with the refreshed idf and post them to the side lists
+    for (DenseId id : ids) {
+        if (!artists.contains(id)) continue;
+        vector<TagPosting>& vector_of = patched_vectors_[id];
+        weigh(artists[id], vector_of);
+        for (const TagPosting& term : vector_of) {
+            vector<TagPosting>& list = patched_postings_[term.id].postings;
+            auto pos = lower_bound(list.begin(), list.end(), id,
+                [](const TagPosting& posting, DenseId artist) { return posting.id < artist; });
+            list.insert(pos, {id, term.weight});
+        }
+    }
+    for (Symbol tag : touched) {
+        PatchedList& list = patched_postings_[tag];
+        list.max_weight = 0.0f;
+        for (const TagPosting& posting : list.postings) list.max_weight = max(list.max_weight, posting.weight);
+    }
+}
+
+vector<Symbol> TagIndex::distinctTags(const Artist& artist) {
+    vector<Symbol> distinct(artist.tags.begin(), artist.tags.end());
+    sort(distinct.begin(), distinct.end());
+    distinct.erase(unique(distinct.begin(), distinct.end()), distinct.end());
+    return distinct;
+}
+
+void TagIndex::weigh(const Artist& artist, vector<TagPosting>& out) const {
+    vector<Symbol> sorted(artist.tags.begin(), artist.tags.end());
+    sort(sorted.begin(), sorted.end());
+
+    size_t first = out.size();
+    double sum = 0.0;
+    for (size_t i = 0; i < sorted.size();) {
+        size_t j = i;
+        while (j < sorted.size() && sorted[j] == sorted[i]) ++j;
+        double weight = (1.0 + log(static_cast<double>(j - i))) * idf_[sorted[i]];
+        out.push_back({sorted[i], static_cast<float>(weight)});
+        sum += weight * weight;
+        i = j;
+    }
+    double norm = sqrt(sum);
+    if (norm > 0.0) {
+        for (size_t i = first; i < out.size(); ++i) out[i].weight /= static_cast<float>(norm);
+    }
+}
+
+void TagIndex::clear() {
+    artist_bound_ = 0;
+    vector_offsets_.clear();
+    vectors_.clear();
+    posting_offsets_.clear();
+    postings_.clear();
+    max_weight_.clear();
+    idf_.clear();
+    df_.clear();
+    live_artists_ = 0;
+    live_.clear();
+    patched_vectors_.clear();
+    patched_postings_.clear();
+    stale_.clear();
+}
+
+const TagPosting* TagIndex::vectorBegin(DenseId artist) const {
+    if (stale(artist)) {
+        auto it = patched_vectors_.find(artist);
+        return it != patched_vectors_.end() ? it->second.data() : nullptr;
+    }
+    return artist + 1 < vector_offsets_.size() ? vectors_.data() + vector_offsets_[artist] : nullptr;
+}
+
+const TagPosting* TagIndex::vectorEnd(DenseId artist) const {
+    if (stale(artist)) {
+        auto it = patched_vectors_.find(artist);
+        return it != patched_vectors_.end() ? it->second.data() + it->second.size() : nullptr;
+    }
+    return artist + 1 < vector_offsets_.size() ? vectors_.data() + vector_offsets_[artist + 1] : nullptr;
+}
+
+vector<TagMatch> TagIndex::topK(DenseId seed, size_t k, const function<bool(DenseId)>& accept,
+                                size_t* postings_read) const {
+    struct Cursor {
+        const TagPosting* current;
+        const TagPosting* end;
+        double query_weight;
+        double bound; // query_weight * the list's largest weight
+        bool base;    // a base list, whose postings of patched artists are stale
+    };
+
+    size_t read = 0;
+    vector<TagMatch> results;
+    if (k == 0 || seed >= artistBound()) {
+        if (postings_read) *postings_read = read;
+        return results;
+    }
+
+    // One cursor per base list, plus one per side list of patched artists
+    vector<Cursor> cursors;
+    for (const TagPosting* term = vectorBegin(seed); term != vectorEnd(seed); ++term) {
+        const TagPosting* first = postings_.data() + posting_offsets_[term->id];
+        const TagPosting* last = postings_.data() + posting_offsets_[term->id + 1];
+        if (first != last) {
+            cursors.push_back({first, last, term->weight, static_cast<double>(term->weight) * max_weight_[term->id], true});
+        }
+        auto patched = patched_postings_.find(term->id);
+        if (patched != patched_postings_.end() && !patched->second.postings.empty()) {
+            const vector<TagPosting>& list = patched->second.postings;
+            cursors.push_back({list.data(), list.data() + list.size(), term->weight,
+                               static_cast<double>(term->weight) * patched->second.max_weight, false});
+        }
+    }
+
+    // Ascending by bound; prefix_bound[i] = what cursors [0, i] can add at most
+    sort(cursors.begin(), cursors.end(), [](const Cursor& a, const Cursor& b) { return a.bound < b.bound; });
+    vector<double> prefix_bound(cursors.size());
+    double running = 0.0;
+    for (size_t i = 0; i < cursors.size(); ++i) prefix_bound[i] = running += cursors[i].bound;
+
+    // Min-heap of the best k so far; threshold is its smallest score once full
+    auto worse = [](const TagMatch& a, const TagMatch& b) {
+        return a.score != b.score ? a.score > b.score : a.artist < b.artist;
+    };
+    priority_queue<TagMatch, vector<TagMatch>, decltype(worse)> best(worse);
+    double threshold = 0.0;
+    size_t first_essential = 0; // cursors below this index are non-essential
+
+    while (true) {
+        // Next candidate: smallest artist id among the essential lists (stale postings skipped)
+        DenseId candidate = kInvalidDenseId;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            Cursor& cursor = cursors[i];
+            while (cursor.base && cursor.current != cursor.end && stale(cursor.current->id)) {
+                ++cursor.current;
+                ++read;
+            }
+            if (cursor.current != cursor.end) candidate = min(candidate, cursor.current->id);
+        }
+        if (candidate == kInvalidDenseId) break;
+
+        double score = 0.0;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            Cursor& cursor = cursors[i];
+            if (cursor.current != cursor.end && cursor.current->id == candidate) {
+                score += cursor.query_weight * cursor.current->weight;
+                ++cursor.current;
+                ++read;
+            }
+        }
+
+        // Probe the non-essential lists, largest bound first, while they can still matter
+        for (size_t i = first_essential; i-- > 0;) {
+            if (best.size() == k && score + prefix_bound[i] <= threshold) break;
+            Cursor& cursor = cursors[i];
+            cursor.current = lower_bound(cursor.current, cursor.end, candidate,
+                [](const TagPosting& posting, DenseId id) { return posting.id < id; });
+            if (cursor.current != cursor.end && cursor.current->id == candidate && !(cursor.base && stale(candidate))) {
+                score += cursor.query_weight * cursor.current->weight;
+                ++read;
+            }
+        }
+
+        if (candidate == seed || (accept && !accept(candidate))) continue;
+        if (best.size() < k) {
+            best.push({candidate, score});
+        } else if (score > threshold) {
+            best.pop();
+            best.push({candidate, score});
+        } else {
+            continue;
+        }
+
+        // A full heap raises the bar: lists that together cannot reach it stop producing candidates
+        if (best.size() == k) {
+            threshold = best.top().score;
+            while (first_essential < cursors.size() && prefix_bound[first_essential] <= threshold) ++first_essential;
+        }
+    }
+
+    results.reserve(best.size());
+    while (!best.empty()) {
+        results.push_back(best.top());
+        best.pop();
+    }
+    reverse(results.begin(), results.end());
+    if (postings_read) *postings_read = read;
+    return results;
+}
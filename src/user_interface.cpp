@@ -8,6 +8,7 @@
 #include <map>
 #include <thread> // Required for this_thread::sleep_for
 #include <chrono> // Required for chrono::milliseconds
+#include <filesystem>
 using namespace std;
 
 void UserInterface::run() {
@@ -16,7 +17,7 @@ void UserInterface::run() {
 
     string command;
     while(true) {
-        cout << "\nEnter a command (artist/song/help/spotify/ml/exit): ";
+        cout << "\nEnter a command (artist/song/more/tags/search/help/spotify/ml/delta/validate/precision/exit): ";
         getline(cin, command);
 
         if(!processUserCommand(command)) break;
@@ -50,8 +51,14 @@ void UserInterface::displayHelp() {
     cout << "\n=== Available Commands ===" << endl;
     cout << "artist    - Get artist recommendations" << endl;
     cout << "song      - Get song recommendations" << endl;
+    cout << "more      - More songs by the artist of a song" << endl;
+    cout << "tags      - Find artists sharing rare tags with an artist" << endl;
+    cout << "search    - Complete a partial or misspelled artist/song name" << endl;
     cout << "spotify   - Load data from Spotify API" << endl;
     cout << "ml        - Train/re-train ML models" << endl;
+    cout << "delta     - Apply artist/song change files" << endl;
+    cout << "validate  - Check catalog integrity (JSON report)" << endl;
+    cout << "precision - Store song features as float32 or bfloat16" << endl;
     cout << "help      - Display this help message" << endl;
     cout << "exit      - Exit the program" << endl;
     cout << "=========================" << endl;
@@ -71,14 +78,49 @@ bool UserInterface::processUserCommand(const string& command) {
         return false;
     } else if(command == "song") {
         string song_title = getUserInput("Enter the song title: ");
-        handleSongRecommendation(song_title);
+        CatalogSnapshot catalog = currentCatalog();
+        RecommendationEngine& engine = *catalog->engine;
+        if (!engine.hasSong(song_title)) song_title = autocomplete(song_title, engine.suggestSongs(song_title));
+        handleSongRecommendation(song_title, *catalog);
     } else if(command == "artist") {
         string artist_name = getUserInput("Enter the artist name: ");
-        handleArtistRecommendation(artist_name);
+        CatalogSnapshot catalog = currentCatalog();
+        RecommendationEngine& engine = *catalog->engine;
+        if (!engine.hasArtist(artist_name)) artist_name = autocomplete(artist_name, engine.suggestArtists(artist_name));
+        handleArtistRecommendation(artist_name, *catalog);
+    } else if(command == "more") {
+        string song_title = getUserInput("Enter the song title: ");
+        CatalogSnapshot catalog = currentCatalog();
+        RecommendationEngine& engine = *catalog->engine;
+        if (!engine.hasSong(song_title)) song_title = autocomplete(song_title, engine.suggestSongs(song_title));
+        cout << "\nMore by the artist of: " << song_title << endl;
+        displayRecommendations(engine.recommendMoreByArtist(song_title, catalog->songs, catalog->artists));
+    } else if(command == "tags") {
+        string artist_name = getUserInput("Enter the artist name: ");
+        CatalogSnapshot catalog = currentCatalog();
+        RecommendationEngine& engine = *catalog->engine;
+        if (!engine.hasArtist(artist_name)) artist_name = autocomplete(artist_name, engine.suggestArtists(artist_name));
+        cout << "\nArtists sharing rare tags with: " << artist_name << endl;
+        displayRecommendations(engine.recommendArtistsByRareTags(artist_name, catalog->artists));
+    } else if(command == "search") {
+        string query = getUserInput("Search for: ");
+        handleSearch(query, *currentCatalog());
     } else if(command == "spotify") {
         loadSpotifyData();
     } else if(command == "ml") {
-        trainMLModels();
+        if (updateRunning()) return true;
+        catalog_.update([this](CatalogVersion& next) {
+            indexVersion(next);
+            return true;
+        });
+    } else if(command == "delta") {
+        applyDeltas();
+    } else if(command == "validate") {
+        CatalogSnapshot catalog = currentCatalog();
+        loader_.validateData(catalog->artists, catalog->songs, &catalog->engine->getSongStore());
+        cout << loader_.getLastValidationReport().toJSON() << endl;
+    } else if(command == "precision") {
+        handlePrecision(getUserInput("Feature storage (float32/bf16, Enter to keep): "));
     } else {
         cout << "Invalid command. Type 'help' for available commands." << endl;
     }
@@ -88,17 +130,121 @@ bool UserInterface::processUserCommand(const string& command) {
 void UserInterface::loadData() {
     cout << "Loading data..." << endl;
     
-    DataLoader loader;
-    bool loaded = loader.loadArtistsFromCSV("data/artists.csv", artists_);
-    loaded &= loader.loadSongsFromCSV("data/songs.csv", songs_);
+    const string artists_csv = "data/artists.csv";
+    const string songs_csv = "data/songs.csv";
+    const string catalog_json = "data/catalog.json";
+    const string snapshot = "data/catalog.snap";
+    const string song_columns = "data/songs.cols";
+
+    bool loaded = false;
+    bool parsed = false; // loaded from the source files, so the snapshot is rewritten
+    ArtistDatabase artists;
+    SongDatabase songs;
+    ClusterAssignments saved_clusters;
+    string saved_indexes;
+
+    // A JSON catalog, when present, is the source instead of the CSV pair
+    error_code ec;
+    bool from_json = filesystem::exists(catalog_json, ec);
+    vector<string> sources = from_json ? vector<string>{catalog_json} : vector<string>{artists_csv, songs_csv};
+
+    // Prefer the binary snapshot when it is newer than every source file
+    auto snapshot_time = filesystem::last_write_time(snapshot, ec);
+    bool snapshot_fresh = !ec;
+    for (const string& source : sources) {
+        snapshot_fresh = snapshot_fresh && snapshot_time >= filesystem::last_write_time(source, ec) && !ec;
+    }
+
+    if (snapshot_fresh && loader_.loadFromSnapshot(snapshot, artists, songs, &saved_clusters, &saved_indexes)) {
+        loader_.printLoadStats("records from snapshot");
+        loaded = true;
+    } else {
+        if (from_json) {
+            loaded = loader_.loadFromJSON(catalog_json, artists, songs);
+            if (loaded) loader_.printLoadStats("records from JSON");
+        } else {
+            loaded = loader_.loadArtistsFromCSVParallel(artists_csv, artists);
+            if (loaded) loader_.printLoadStats("artists");
+            loaded &= loader_.loadSongsFromCSVParallel(songs_csv, songs);
+            if (loaded) loader_.printLoadStats("songs");
+        }
+
+        // Give every artist's songs consecutive ids (and store rows) before the
+        // catalog is persisted, so later loads get the same layout
+        if (loaded) songs.reorder(ArtistSongIndex::artistOrder(artists, songs));
+
+        parsed = loaded;
+        if (loaded && !ColumnarCatalog::write(song_columns, songs)) {
+            cout << "Could not write columnar song catalog to " << song_columns << endl;
+        }
+    }
+    
+    if (!loaded) {
+        cout << "Failed to load data from " << (from_json ? "the JSON catalog." : "CSV files.") << endl;
+        artists.clear();
+        songs.clear();
+    }
+    
+    // Publish the loaded catalog (an empty one when loading failed) as the next
+    // version, together with its indexes and ML models (a snapshot's persisted
+    // indexes are taken as they are; failing that, its clustering replaces the
+    // k-means run)
+    CatalogSnapshot catalog = catalog_.update([&](CatalogVersion& next) {
+        next.artists = std::move(artists);
+        next.songs = std::move(songs);
+        indexVersion(next, &saved_clusters, &saved_indexes);
+        return true;
+    });
+    saved_indexes = string();
+    
+    // Persist a freshly parsed catalog with the clustering and indexes just built for it
+    if (parsed) {
+        ClusterAssignments clusters = catalog->engine->exportClusters(catalog->artists);
+        string indexes = catalog->engine->saveIndexes();
+        if (!loader_.saveSnapshot(snapshot, catalog->artists, catalog->songs, &clusters, &indexes)) {
+            cout << "Could not write catalog snapshot to " << snapshot << endl;
+        }
+    }
+    
+    // Song results are named from the columnar catalog, which maps columns on demand;
+    // its rows must line up with the dense song ids. A file from an older
+    // format version is rewritten from the loaded catalog.
+    bool columns_open = loaded && song_columns_.open(song_columns);
+    if (loaded && !columns_open && !parsed && catalog->songs.tombstones() == 0 &&
+        ColumnarCatalog::write(song_columns, catalog->songs)) {
+        columns_open = song_columns_.open(song_columns);
+    }
+    if (columns_open &&
+        (song_columns_.size() != catalog->songs.size() || catalog->songs.tombstones() > 0)) {
+        song_columns_.close();
+    }
+    columns_version_ = catalog->number;
     
     if (loaded) {
-        cout << "Loaded " << artists_.size() << " artists and " << songs_.size() << " songs from CSV." << endl;
+        cout << "Loaded " << catalog->artists.size() << " artists and " << catalog->songs.size() << " songs." << endl;
+
+        InternStats interned = SymbolTable::global().getStats();
+        cout << "Interned " << interned.distinct << " distinct genres/tags, hit rate "
+             << fixed << setprecision(1) << interned.hitRate() * 100.0 << "%, "
+             << interned.bytesSaved() / 1024 << " KB saved" << endl;
+        cout.unsetf(ios::fixed);
+        cout << setprecision(6);
         
-        // Train ML models with loaded data
-        trainMLModels();
-    } else {
-        cout << "Failed to load data from CSV files." << endl;
+        if (!loader_.validateData(catalog->artists, catalog->songs, &catalog->engine->getSongStore())) {
+            cout << "Data validation found " << loader_.getLastValidationReport().errorCount()
+                 << " issues (type 'validate' for the report)." << endl;
+        }
+        size_t unknown_genres = loader_.getLastValidationReport().unknown_genres;
+        if (unknown_genres > 0) {
+            cout << unknown_genres << " artists have a genre the feature encoder does not know (type 'validate' for samples)." << endl;
+        }
+        
+        const SongStore& store = catalog->engine->getSongStore();
+        cout << "Song store: " << fixed << setprecision(1) << store.bytesPerSong() << " bytes/song ("
+             << store.stride() << "-wide " << precisionName(store.precision()) << " aligned rows) vs " << SongStore::recordBytesPerSong(catalog->songs)
+             << " bytes/song in Song records" << endl;
+        cout.unsetf(ios::fixed);
+        cout << setprecision(6);
     }
 }
 
@@ -112,55 +258,118 @@ void UserInterface::loadSpotifyData() {
         return;
     }
     
-    // Initialize Spotify API
-    SpotifyAPI spotify_api;
-    spotify_api.setAccessToken(access_token);
-    
-    // Get artist names to search for
-    vector<string> artist_names = {
-        "Travis Scott", "Drake", "Kendrick Lamar", "J. Cole", "Post Malone",
-        "The Weeknd", "Dua Lipa", "Billie Eilish", "Taylor Swift", "Ariana Grande",
-        "Bad Bunny", "Ed Sheeran", "Justin Bieber", "BTS", "Blackpink"
-    };
+    if (updateRunning()) return;
     
-    cout << "Searching for artists on Spotify..." << endl;
-    artists_.clear();
-    
-    for (const auto& name : artist_names) {
-        Artist artist = spotify_api.searchArtist(name);
-        if (!artist.id.empty()) {
-            artists_[artist.id] = artist;
-            cout << "Found: " << artist.name << " (" << artist.genre << ")" << endl;
-            
-            // Get top tracks for this artist
-            vector<Song> tracks = spotify_api.getArtistTopTracks(artist.id);
-            for (const auto& track : tracks) {
-                songs_[track.id] = track;
+    // Fetch and merge on a background thread into the next catalog version;
+    // queries keep using the current version until it is published
+    cout << "Loading from Spotify in the background; queries use the current catalog meanwhile." << endl;
+    catalog_.updateAsync([this, access_token](CatalogVersion& next) {
+        // Initialize Spotify API
+        SpotifyAPI spotify_api;
+        spotify_api.setAccessToken(access_token);
+        
+        // Get artist names to search for
+        vector<string> artist_names = {
+            "Travis Scott", "Drake", "Kendrick Lamar", "J. Cole", "Post Malone",
+            "The Weeknd", "Dua Lipa", "Billie Eilish", "Taylor Swift", "Ariana Grande",
+            "Bad Bunny", "Ed Sheeran", "Justin Bieber", "BTS", "Blackpink"
+        };
+        
+        cout << "Searching for artists on Spotify..." << endl;
+        vector<Artist> fetched_artists;
+        vector<Song> fetched_songs;
+        
+        for (const auto& name : artist_names) {
+            Artist artist = spotify_api.searchArtist(name);
+            if (!artist.id.empty()) {
+                cout << "Found: " << artist.name << " (" << symbolName(artist.genre) << ")" << endl;
+                
+                // Get top tracks for this artist
+                vector<Song> tracks = spotify_api.getArtistTopTracks(artist.id.str());
+                for (auto& track : tracks) {
+                    fetched_songs.push_back(std::move(track));
+                }
+                fetched_artists.push_back(std::move(artist));
             }
+            
+            // Add delay to respect rate limits
+            this_thread::sleep_for(chrono::milliseconds(200));
         }
         
-        // Add delay to respect rate limits
-        this_thread::sleep_for(chrono::milliseconds(200));
-    }
+        // Get audio features for the fetched songs only
+        cout << "Getting audio features for songs..." << endl;
+        spotify_api.populateAudioFeatures(fetched_songs);
+        
+        // Merge into the catalog by id, Spotify records superseding CSV ones
+        MergeStats artist_merge = merger_.mergeArtists(next.artists, std::move(fetched_artists), RecordSource::Spotify);
+        MergeStats song_merge = merger_.mergeSongs(next.songs, std::move(fetched_songs), RecordSource::Spotify);
+        
+        // Deleted records left tombstones; the new version is re-indexed from scratch anyway.
+        // Songs are renumbered grouped by artist, which also drops their tombstones.
+        merger_.compactArtists(next.artists);
+        merger_.reorderSongs(next.songs, ArtistSongIndex::artistOrder(next.artists, next.songs));
+        
+        cout << "Merged " << artist_merge.inserted << " new and " << artist_merge.replaced << " updated artists, "
+             << song_merge.inserted << " new and " << song_merge.replaced << " updated songs from Spotify." << endl;
+        
+        // Index and train here, off the query thread; queries switch to the new
+        // indexes together with the catalog they were built from
+        indexVersion(next);
+        cout << "Publishing catalog version " << next.number << " with " << next.artists.size() << " artists and "
+             << next.songs.size() << " songs." << endl;
+        return true;
+    });
+}
+
+void UserInterface::applyDeltas() {
+    string artist_file = getUserInput("Artist change file (empty to skip): ");
+    string song_file = getUserInput("Song change file (empty to skip): ");
+    if (updateRunning()) return;
     
-    // Get audio features for all songs
-    cout << "Getting audio features for songs..." << endl;
-    vector<Song> song_list;
-    for (const auto& [id, song] : songs_) {
-        song_list.push_back(song);
-    }
-    spotify_api.populateAudioFeatures(song_list);
+    // Each change file becomes one catalog version; its engine is a copy of the
+    // predecessor's (sharing every index the change does not write) with the
+    // changes folded in incrementally
+    auto updateEngine = [](CatalogVersion& next, const function<void(RecommendationEngine&)>& apply) {
+        auto engine = make_shared<RecommendationEngine>(*next.engine);
+        apply(*engine);
+        next.engine = std::move(engine);
+    };
     
-    // Update songs_ with the enhanced data
-    songs_.clear();
-    for (const auto& song : song_list) {
-        songs_[song.id] = song;
+    if (!artist_file.empty()) {
+        DeltaResult delta;
+        CatalogSnapshot catalog = catalog_.update([&](CatalogVersion& next) {
+            if (!loader_.applyArtistDelta(artist_file, next.artists, delta)) return false;
+            for (const auto& id : delta.deleted_ids) merger_.forgetArtist(id);
+            updateEngine(next, [&](RecommendationEngine& engine) {
+                engine.updateArtists(next.artists, next.songs, delta.upserted_ids, delta.deleted_ids, next.number);
+            });
+            return true;
+        });
+        if (catalog) {
+            cout << "Artists: " << delta.upserted_ids.size() << " upserted, " << delta.deleted_ids.size()
+                 << " deleted, " << delta.rejected << " rejected" << endl;
+        } else {
+            cout << "Could not open " << artist_file << endl;
+        }
     }
     
-    cout << "Loaded " << artists_.size() << " artists and " << songs_.size() << " songs from Spotify." << endl;
-    
-    // Train ML models with new data
-    trainMLModels();
+    if (!song_file.empty()) {
+        DeltaResult delta;
+        CatalogSnapshot catalog = catalog_.update([&](CatalogVersion& next) {
+            if (!loader_.applySongDelta(song_file, next.songs, delta)) return false;
+            for (const auto& id : delta.deleted_ids) merger_.forgetSong(id);
+            updateEngine(next, [&](RecommendationEngine& engine) {
+                engine.updateSongs(next.songs, next.artists, delta.upserted_ids, delta.deleted_ids, next.number);
+            });
+            return true;
+        });
+        if (catalog) {
+            cout << "Songs: " << delta.upserted_ids.size() << " upserted, " << delta.deleted_ids.size()
+                 << " deleted, " << delta.rejected << " rejected" << endl;
+        } else {
+            cout << "Could not open " << song_file << endl;
+        }
+    }
 }
 
 string UserInterface::getSpotifyAccessToken() {
@@ -172,25 +381,122 @@ string UserInterface::getSpotifyAccessToken() {
     return "your_access_token_here";
 }
 
-void UserInterface::trainMLModels() {
-    if (artists_.empty() && songs_.empty()) {
-        cout << "No data available to train ML models." << endl;
-        return;
+// Build a fresh engine for a new version inside its writer: every index, the
+// song store and the ML models, keeping the previous engine's settings
+void UserInterface::indexVersion(CatalogVersion& next, const ClusterAssignments* saved, const string* indexes) {
+    auto engine = make_shared<RecommendationEngine>();
+    if (next.engine) engine->copySettings(*next.engine);
+    
+    if (indexes && !indexes->empty()) {
+        if (engine->loadIndexes(*indexes, next.artists, next.songs, next.number)) {
+            cout << "Indexes and ML models restored from snapshot" << endl;
+            next.engine = std::move(engine);
+            return;
+        }
+        cout << "Snapshot indexes do not match the catalog; rebuilding them" << endl;
+        engine = make_shared<RecommendationEngine>();
+        if (next.engine) engine->copySettings(*next.engine);
     }
+    engine->indexCatalog(next.artists, next.songs, next.number);
     
-    cout << "Training machine learning models..." << endl;
-    engine_.trainMLModels(artists_, songs_);
-    cout << "ML models trained successfully!" << endl;
+    if (next.artists.empty() && next.songs.empty()) {
+        cout << "No data available to train ML models." << endl;
+    } else {
+        cout << "Training machine learning models..." << endl;
+        engine->trainMLModels(next.artists, next.songs, saved);
+        cout << "ML models trained successfully!" << endl;
+    }
+    next.engine = std::move(engine);
+}
+
+// Changes from the REPL wait for nothing: while a background update is
+// running they are refused instead of blocking on the writer lock
+bool UserInterface::updateRunning() const {
+    if (!catalog_.updatePending()) return false;
+    cout << "A catalog update is running in the background; try again once it is published." << endl;
+    return true;
+}
+
+// Pin the current catalog version for a query; its engine was built for it.
+// The on-disk song columns match the version loaded at startup only.
+CatalogSnapshot UserInterface::currentCatalog() {
+    CatalogSnapshot catalog = catalog_.acquire();
+    if (catalog->number != columns_version_) song_columns_.close();
+    return catalog;
 }
 
-void UserInterface::handleArtistRecommendation(const string& artist_name) {
+void UserInterface::handleArtistRecommendation(const string& artist_name, const CatalogVersion& catalog) {
     cout << "\nGetting recommendations for: " << artist_name << endl;
-    auto recs = engine_.recommendSimilarArtists(artist_name, artists_);
+    auto recs = catalog.engine->recommendSimilarArtists(artist_name, catalog.artists);
     displayRecommendations(recs);
 }
 
-void UserInterface::handleSongRecommendation(const string& song_title) {
+void UserInterface::handleSongRecommendation(const string& song_title, const CatalogVersion& catalog) {
     cout << "\nGetting recommendations for: " << song_title << endl;
-    auto recs = engine_.recommendSimilarSongs(song_title, songs_, artists_);
+    auto recs = song_columns_.isOpen()
+        ? catalog.engine->recommendSimilarSongs(song_title, song_columns_)
+        : catalog.engine->recommendSimilarSongs(song_title, catalog.songs);
     displayRecommendations(recs);
-}
\ No newline at end of file
+}
+
+void UserInterface::handleSearch(const string& query, const CatalogVersion& catalog) {
+    auto show = [](const string& heading, const vector<SearchHit>& hits) {
+        cout << heading << endl;
+        if (hits.empty()) cout << "   (no matches)" << endl;
+        for (size_t i = 0; i < hits.size(); ++i) {
+            cout << "   " << (i + 1) << ". " << hits[i].name;
+            if (hits[i].records > 1) cout << " (" << hits[i].records << " records)";
+            cout << endl;
+        }
+    };
+    show("Artists:", catalog.engine->suggestArtists(query));
+    show("Songs:", catalog.engine->suggestSongs(query));
+}
+
+void UserInterface::handlePrecision(const string& choice) {
+    if (choice == "float32" || choice == "bf16" || choice == "bfloat16") {
+        if (updateRunning()) return;
+        FeaturePrecision precision = choice == "float32" ? FeaturePrecision::Float32 : FeaturePrecision::BFloat16;
+        // the song store is rebuilt on a copy of the engine (the other indexes stay
+        // shared) and published as the next version
+        catalog_.update([precision](CatalogVersion& next) {
+            auto engine = make_shared<RecommendationEngine>(*next.engine);
+            engine->setFeaturePrecision(precision, next.artists, next.songs);
+            next.engine = std::move(engine);
+            return true;
+        });
+    } else if (!choice.empty()) {
+        cout << "Unknown precision: " << choice << endl;
+        return;
+    }
+
+    CatalogSnapshot catalog = currentCatalog();
+    const SongStore& store = catalog->engine->getSongStore();
+    PrecisionReport report = catalog->engine->checkFeaturePrecision(catalog->songs);
+    cout << "Song features stored as " << precisionName(report.precision) << " ("
+         << fixed << setprecision(1) << store.bytesPerSong() << " bytes/song)" << endl;
+    cout << "Against double precision over " << report.queries << " queries: max score error "
+         << scientific << setprecision(2) << report.max_score_error << ", max rank shift "
+         << report.max_rank_shift << ", top-" << report.top_k << " overlap >= "
+         << fixed << setprecision(0) << report.min_top_k_overlap * 100 << "%" << endl;
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+}
+
+string UserInterface::autocomplete(const string& input, const vector<SearchHit>& suggestions) {
+    if (suggestions.empty()) return input;
+
+    cout << "No exact match for \"" << input << "\". Did you mean:" << endl;
+    for (size_t i = 0; i < suggestions.size(); ++i) {
+        cout << "   " << (i + 1) << ". " << suggestions[i].name << endl;
+    }
+
+    string choice = getUserInput("Pick a number (Enter to keep your input): ");
+    size_t pick = 0;
+    try {
+        pick = choice.empty() ? 0 : stoul(choice);
+    } catch (const exception&) {
+        pick = 0;
+    }
+    return (pick >= 1 && pick <= suggestions.size()) ? suggestions[pick - 1].name : input;
+}